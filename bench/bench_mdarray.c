@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mdarray.h"
+
+// Metadata-bound MDArray workloads: many views, many small tensors and
+// element access, where allocations and pointer chasing dominate the
+// arithmetic. Prints nanoseconds per operation.
+//
+//   bench_mdarray [iterations]
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Keeps the compiler from dropping the measured work
+static volatile double sink;
+
+static void bench_views(size_t iterations) {
+    size_t shape[] = {784, 64};
+    MDArray* arr = mdarray_create(2, shape, sizeof(double));
+    mdarray_ones(arr);
+
+    double start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        MDArray* slice = mdarray_slice(arr, 1, i % 32, i % 32 + 32);
+        MDArray* transposed = mdarray_transpose_view(slice);
+        MDArray* row = mdarray_copy(transposed, 1, (size_t[]){i % 32});
+        sink += ((double*)row->data)[0];
+        mdarray_free(row);
+        mdarray_free(transposed);
+        mdarray_free(slice);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("views (slice + transpose + row):  %8.1f ns/iter\n", elapsed / iterations);
+    mdarray_free(arr);
+}
+
+static void bench_small_tensors(size_t iterations) {
+    size_t shape[] = {10, 1};
+
+    double start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        MDArray* a = mdarray_create(2, shape, sizeof(double));
+        MDArray* b = mdarray_create(2, shape, sizeof(double));
+        mdarray_ones(a);
+        mdarray_ones(b);
+        MDArray* sum = mdarray_sum(a, b);
+        sink += ((double*)sum->data)[i % 10];
+        mdarray_free(sum);
+        mdarray_free(b);
+        mdarray_free(a);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("small tensors (2 create + sum):   %8.1f ns/iter\n", elapsed / iterations);
+}
+
+static void bench_element_access(size_t iterations) {
+    size_t shape[] = {28, 28};
+    MDArray* arr = mdarray_create(2, shape, sizeof(double));
+    mdarray_ones(arr);
+
+    size_t rounds = iterations / arr->total_size + 1;
+    double start = now_ns();
+    double total = 0.0;
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < 28; i++) {
+            for (size_t j = 0; j < 28; j++) {
+                size_t indices[] = {i, j};
+                total += *(double*)mdarray_get_element(arr, indices);
+            }
+        }
+    }
+    double elapsed = now_ns() - start;
+    sink += total;
+
+    printf("element access (get_element):     %8.1f ns/element\n", elapsed / (rounds * arr->total_size));
+    mdarray_free(arr);
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+
+    bench_views(iterations);
+    bench_small_tensors(iterations);
+    bench_element_access(iterations * 10);
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "allocator.h"
+
+#define MPOL_BIND 2
+#define NUMA_MAX_NODES 1024
+#define PAGE_SIZE 4096
+
+typedef enum {
+    BLOCK_HEAP,
+    BLOCK_MAPPED
+} BlockKind;
+
+// Stored in the ALLOCATOR_ALIGNMENT bytes right before each default buffer
+typedef struct {
+    BlockKind kind;
+    void* base;        // Start of the heap block or mapping
+    size_t length;     // Length of the mapping, 0 for heap blocks
+} BlockHeader;
+
+static void* default_alloc(void* ctx, size_t bytes);
+static void default_free(void* ctx, void* ptr, size_t bytes);
+
+static Allocator default_allocator = {default_alloc, default_free, NULL};
+static Allocator current_allocator = {default_alloc, default_free, NULL};
+
+static AllocatorConfig config = {ALLOCATOR_HUGE_PAGE_THRESHOLD, HUGE_PAGES_TRANSPARENT, 0};
+
+static atomic_size_t live_bytes;
+static atomic_size_t peak_bytes;
+static atomic_size_t allocations;
+static atomic_size_t huge_allocations;
+
+static size_t round_up(size_t n, size_t multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+// Bind the range to the NUMA node the calling thread runs on, then fault
+// every page in from this thread so first touch agrees with the policy.
+// Silently does nothing where mbind is unavailable or not permitted.
+static void bind_to_current_node(void* addr, size_t length) {
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < NUMA_MAX_NODES) {
+        unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+        mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, addr, length, MPOL_BIND, mask, NUMA_MAX_NODES + 1, 0);
+    }
+#endif
+
+    for (size_t offset = 0; offset < length; offset += PAGE_SIZE) {
+        ((volatile char*)addr)[offset] = 0;
+    }
+}
+
+static void* map_huge(size_t length) {
+#ifdef MAP_HUGETLB
+    if (config.huge_pages == HUGE_PAGES_EXPLICIT) {
+        void* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) return base;
+    }
+#endif
+
+    // Over-map so the block can start on a huge page boundary, then trim
+    size_t padded = length + ALLOCATOR_HUGE_PAGE_SIZE;
+    char* raw = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+
+    char* base = (char*)round_up((uintptr_t)raw, ALLOCATOR_HUGE_PAGE_SIZE);
+    if (base > raw) munmap(raw, base - raw);
+    if (raw + padded > base + length) munmap(base + length, raw + padded - (base + length));
+
+#ifdef MADV_HUGEPAGE
+    if (config.huge_pages != HUGE_PAGES_OFF) madvise(base, length, MADV_HUGEPAGE);
+#endif
+
+    return base;
+}
+
+static void* default_alloc(void* ctx, size_t bytes) {
+    (void)ctx;
+    BlockHeader header;
+    char* base;
+
+    if (config.huge_pages != HUGE_PAGES_OFF && bytes >= config.huge_page_threshold) {
+        header.kind = BLOCK_MAPPED;
+        header.length = round_up(bytes + ALLOCATOR_ALIGNMENT, ALLOCATOR_HUGE_PAGE_SIZE);
+        base = map_huge(header.length);
+        if (!base) return NULL;
+        if (config.numa_first_touch) bind_to_current_node(base, header.length);
+        atomic_fetch_add(&huge_allocations, 1);
+    } else {
+        header.kind = BLOCK_HEAP;
+        header.length = 0;
+        base = aligned_alloc(ALLOCATOR_ALIGNMENT, ALLOCATOR_ALIGNMENT + round_up(bytes, ALLOCATOR_ALIGNMENT));
+        if (!base) return NULL;
+    }
+
+    header.base = base;
+    char* ptr = base + ALLOCATOR_ALIGNMENT;
+    *(BlockHeader*)(ptr - sizeof(BlockHeader)) = header;
+    return ptr;
+}
+
+static void default_free(void* ctx, void* ptr, size_t bytes) {
+    (void)ctx;
+    (void)bytes;
+    BlockHeader* header = (BlockHeader*)((char*)ptr - sizeof(BlockHeader));
+
+    if (header->kind == BLOCK_MAPPED) {
+        munmap(header->base, header->length);
+    } else {
+        free(header->base);
+    }
+}
+
+void allocator_set(const Allocator* allocator) {
+    current_allocator = allocator ? *allocator : default_allocator;
+}
+
+void allocator_configure(const AllocatorConfig* new_config) {
+    config = new_config ? *new_config : allocator_default_config();
+}
+
+AllocatorConfig allocator_default_config(void) {
+    AllocatorConfig defaults = {ALLOCATOR_HUGE_PAGE_THRESHOLD, HUGE_PAGES_TRANSPARENT, 0};
+    return defaults;
+}
+
+void* allocator_alloc(size_t bytes) {
+    void* ptr = current_allocator.alloc(current_allocator.ctx, bytes);
+    if (!ptr) return NULL;
+
+    size_t live = atomic_fetch_add(&live_bytes, bytes) + bytes;
+    size_t peak = atomic_load(&peak_bytes);
+    while (live > peak && !atomic_compare_exchange_weak(&peak_bytes, &peak, live)) {
+    }
+    atomic_fetch_add(&allocations, 1);
+
+    return ptr;
+}
+
+void allocator_free(void* ptr, size_t bytes) {
+    if (!ptr) return;
+
+    current_allocator.free(current_allocator.ctx, ptr, bytes);
+    atomic_fetch_sub(&live_bytes, bytes);
+}
+
+AllocatorStats allocator_stats(void) {
+    AllocatorStats stats;
+    stats.live_bytes = atomic_load(&live_bytes);
+    stats.peak_bytes = atomic_load(&peak_bytes);
+    stats.allocations = atomic_load(&allocations);
+    stats.huge_allocations = atomic_load(&huge_allocations);
+    return stats;
+}
+
+void allocator_reset_peak(void) {
+    atomic_store(&peak_bytes, atomic_load(&live_bytes));
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+
+// Every buffer handed out is aligned to at least this many bytes
+#define ALLOCATOR_ALIGNMENT 64
+
+// Default size above which buffers are mmap'd and backed by huge pages
+#define ALLOCATOR_HUGE_PAGE_THRESHOLD (4 * 1024 * 1024)
+#define ALLOCATOR_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef enum {
+    HUGE_PAGES_OFF,         // Large buffers use regular pages
+    HUGE_PAGES_TRANSPARENT, // madvise(MADV_HUGEPAGE) on large buffers
+    HUGE_PAGES_EXPLICIT     // MAP_HUGETLB, falling back to transparent huge pages
+} HugePageMode;
+
+typedef struct {
+    size_t huge_page_threshold; // Buffers of at least this many bytes get huge pages
+    HugePageMode huge_pages;
+    int numa_first_touch;       // 1 to bind large buffers to the allocating thread's NUMA node
+} AllocatorConfig;
+
+typedef struct {
+    size_t live_bytes;          // Bytes currently allocated
+    size_t peak_bytes;          // Maximum of live_bytes since the last reset
+    size_t allocations;         // Number of successful allocations
+    size_t huge_allocations;    // Allocations that took the huge page path
+} AllocatorStats;
+
+// Pluggable backend for MDArray data buffers. alloc must return memory
+// aligned to ALLOCATOR_ALIGNMENT. free receives the size passed to alloc.
+typedef struct {
+    void* (*alloc)(void* ctx, size_t bytes);
+    void (*free)(void* ctx, void* ptr, size_t bytes);
+    void* ctx;
+} Allocator;
+
+// Install a custom allocator, NULL restores the default one. Only swap
+// allocators while no buffer from the previous one is alive.
+void allocator_set(const Allocator* allocator);
+void allocator_configure(const AllocatorConfig* config);
+AllocatorConfig allocator_default_config(void);
+
+void* allocator_alloc(size_t bytes);
+void allocator_free(void* ptr, size_t bytes);
+
+AllocatorStats allocator_stats(void);
+void allocator_reset_peak(void);
@@ -0,0 +1,310 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "autotune.h"
+#include "mdarray.h"
+#include "parallel.h"
+#include "rng.h"
+
+#define AUTOTUNE_CPU_MODEL_LEN 128
+#define AUTOTUNE_PATH_LEN 1024
+#define AUTOTUNE_REPEATS 3
+
+// Winning configuration for one shape class on one CPU model. Entries for
+// other CPUs are kept so a cache shared across a mixed fleet survives saves.
+typedef struct {
+    char cpu[AUTOTUNE_CPU_MODEL_LEN];
+    unsigned mb, nb, kb; // log2 buckets of m, n and k
+    GemmConfig config;
+} TuningEntry;
+
+static TuningEntry entries[AUTOTUNE_MAX_ENTRIES];
+static size_t n_entries = 0;
+static pthread_mutex_t entries_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t load_once = PTHREAD_ONCE_INIT;
+
+static char cpu_model[AUTOTUNE_CPU_MODEL_LEN];
+static char cache_path[AUTOTUNE_PATH_LEN];
+
+// Smallest b such that 2^b >= x
+static unsigned shape_bucket(size_t x) {
+    unsigned b = 0;
+    while (((size_t)1 << b) < x) b++;
+    return b;
+}
+
+// CPU model plus online CPU count, e.g. "Intel(R) Xeon(R) Gold 6148 CPU @ 2.40GHz/40"
+const char* autotune_cpu_model(void) {
+    if (cpu_model[0]) return cpu_model;
+
+    char model[AUTOTUNE_CPU_MODEL_LEN - 16] = "unknown";
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    if (file) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "model name", 10) != 0) continue;
+            char* value = strchr(line, ':');
+            if (!value) continue;
+            value++;
+            while (*value == ' ') value++;
+            value[strcspn(value, "\t\n")] = '\0';
+            snprintf(model, sizeof(model), "%s", value);
+            break;
+        }
+        fclose(file);
+    }
+
+    snprintf(cpu_model, sizeof(cpu_model), "%s/%zu", model, parallel_num_threads());
+    return cpu_model;
+}
+
+const char* autotune_cache_path(void) {
+    if (cache_path[0]) return cache_path;
+
+    const char* env = getenv(AUTOTUNE_CACHE_ENV);
+    const char* home = getenv("HOME");
+    if (env && env[0]) {
+        snprintf(cache_path, sizeof(cache_path), "%s", env);
+    } else {
+        snprintf(cache_path, sizeof(cache_path), "%s/.cache/nnc/gemm_tuning.tsv", home ? home : ".");
+    }
+    return cache_path;
+}
+
+// Caller holds entries_lock
+static TuningEntry* find_entry(const char* cpu, unsigned mb, unsigned nb, unsigned kb) {
+    for (size_t i = 0; i < n_entries; i++) {
+        if (entries[i].mb == mb && entries[i].nb == nb && entries[i].kb == kb &&
+            strcmp(entries[i].cpu, cpu) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Caller holds entries_lock
+static void store_entry(const char* cpu, unsigned mb, unsigned nb, unsigned kb, const GemmConfig* config) {
+    TuningEntry* entry = find_entry(cpu, mb, nb, kb);
+    if (!entry) {
+        if (n_entries == AUTOTUNE_MAX_ENTRIES) {
+            printf("Tuning cache is full, dropping entry\n");
+            return;
+        }
+        entry = &entries[n_entries++];
+        snprintf(entry->cpu, sizeof(entry->cpu), "%s", cpu);
+        entry->mb = mb;
+        entry->nb = nb;
+        entry->kb = kb;
+    }
+    entry->config = *config;
+}
+
+// Cache format, one tab separated line per entry:
+// <cpu model>\t<mb> <nb> <kb>\t<mc> <kc> <nc> <mr> <nr> <threads>
+int autotune_load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+
+    char line[512];
+    pthread_mutex_lock(&entries_lock);
+    while (fgets(line, sizeof(line), file)) {
+        char* cpu = strtok(line, "\t");
+        char* shape = strtok(NULL, "\t");
+        char* params = strtok(NULL, "\t\n");
+        if (!cpu || !shape || !params) continue;
+
+        unsigned mb, nb, kb;
+        GemmConfig config;
+        if (sscanf(shape, "%u %u %u", &mb, &nb, &kb) != 3) continue;
+        if (sscanf(params, "%zu %zu %zu %zu %zu %zu", &config.mc, &config.kc, &config.nc,
+                   &config.mr, &config.nr, &config.threads) != 6) continue;
+        if (!gemm_config_valid(&config)) continue;
+
+        store_entry(cpu, mb, nb, kb, &config);
+    }
+    pthread_mutex_unlock(&entries_lock);
+
+    fclose(file);
+    return 0;
+}
+
+static void make_parent_dirs(const char* path) {
+    char dir[AUTOTUNE_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char* p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(dir, 0755);
+        *p = '/';
+    }
+}
+
+int autotune_save(const char* path) {
+    make_parent_dirs(path);
+
+    // Write to a temporary file first so readers never see a partial cache,
+    // unique per process so concurrent writers don't share it
+    char tmp_path[AUTOTUNE_PATH_LEN + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long)getpid());
+    FILE* file = fopen(tmp_path, "w");
+    if (!file) {
+        perror("Error opening tuning cache");
+        return -1;
+    }
+
+    pthread_mutex_lock(&entries_lock);
+    for (size_t i = 0; i < n_entries; i++) {
+        TuningEntry* e = &entries[i];
+        fprintf(file, "%s\t%u %u %u\t%zu %zu %zu %zu %zu %zu\n", e->cpu, e->mb, e->nb, e->kb,
+                e->config.mc, e->config.kc, e->config.nc, e->config.mr, e->config.nr, e->config.threads);
+    }
+    pthread_mutex_unlock(&entries_lock);
+
+    // The contents must be on disk before the rename makes them visible
+    int status = fflush(file);
+    status |= fsync(fileno(file));
+    status |= fclose(file);
+    if (status != 0 || rename(tmp_path, path) != 0) {
+        perror("Error writing tuning cache");
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void load_default_cache(void) {
+    autotune_load(autotune_cache_path());
+}
+
+GemmConfig autotune_lookup(size_t m, size_t n, size_t k) {
+    pthread_once(&load_once, load_default_cache);
+
+    GemmConfig config = gemm_default_config();
+    const char* cpu = autotune_cpu_model();
+
+    pthread_mutex_lock(&entries_lock);
+    TuningEntry* entry = find_entry(cpu, shape_bucket(m), shape_bucket(n), shape_bucket(k));
+    if (entry) config = entry->config;
+    pthread_mutex_unlock(&entries_lock);
+
+    return config;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Best of AUTOTUNE_REPEATS runs after one warm-up
+static double time_config(MDArray* a, MDArray* b, MDArray* c, const GemmConfig* config) {
+    size_t m = a->shape[0], k = a->shape[1], n = b->shape[1];
+    double best = -1.0;
+
+    for (int r = 0; r <= AUTOTUNE_REPEATS; r++) {
+        double start = now_seconds();
+        gemm_dgemm(m, n, k, a->data, k, 1, b->data, n, 1, c->data, n, 1, 0, config);
+        double elapsed = now_seconds() - start;
+        if (r > 0 && (best < 0 || elapsed < best)) best = elapsed;
+    }
+
+    return best;
+}
+
+static void try_config(MDArray* a, MDArray* b, MDArray* c, GemmConfig* best, double* best_time,
+                       GemmConfig candidate) {
+    double elapsed = time_config(a, b, c, &candidate);
+    if (elapsed < *best_time) {
+        *best_time = elapsed;
+        *best = candidate;
+    }
+}
+
+static size_t clamp_dim(size_t x) {
+    if (x == 0) return 1;
+    return x < AUTOTUNE_MAX_DIM ? x : AUTOTUNE_MAX_DIM;
+}
+
+// Coordinate search: pick the micro-kernel with default blocking, then
+// kc, mc, nc and thread count in turn, keeping the best of each step
+GemmConfig autotune_gemm(size_t m, size_t n, size_t k) {
+    size_t a_shape[] = {clamp_dim(m), clamp_dim(k)};
+    size_t b_shape[] = {clamp_dim(k), clamp_dim(n)};
+    size_t c_shape[] = {clamp_dim(m), clamp_dim(n)};
+    MDArray* a = mdarray_create(2, a_shape, sizeof(double));
+    MDArray* b = mdarray_create(2, b_shape, sizeof(double));
+    MDArray* c = mdarray_create(2, c_shape, sizeof(double));
+
+    GemmConfig best = gemm_default_config();
+    if (!a || !b || !c) {
+        mdarray_free(a);
+        mdarray_free(b);
+        mdarray_free(c);
+        return best;
+    }
+
+    RNG rng = rng_new(0);
+    rng_uniform(&rng, a, -1.0, 1.0);
+    rng_uniform(&rng, b, -1.0, 1.0);
+
+    double best_time = time_config(a, b, c, &best);
+
+    static const size_t kernels[][2] = {{4, 4}, {4, 8}, {8, 4}, {8, 8}};
+    GemmConfig base = best;
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        GemmConfig candidate = base;
+        candidate.mr = kernels[i][0];
+        candidate.nr = kernels[i][1];
+        try_config(a, b, c, &best, &best_time, candidate);
+    }
+
+    static const size_t kcs[] = {64, 128, 256, 512};
+    base = best;
+    for (size_t i = 0; i < sizeof(kcs) / sizeof(kcs[0]); i++) {
+        GemmConfig candidate = base;
+        candidate.kc = kcs[i];
+        try_config(a, b, c, &best, &best_time, candidate);
+    }
+
+    static const size_t mcs[] = {32, 64, 128, 256};
+    base = best;
+    for (size_t i = 0; i < sizeof(mcs) / sizeof(mcs[0]); i++) {
+        GemmConfig candidate = base;
+        candidate.mc = mcs[i];
+        try_config(a, b, c, &best, &best_time, candidate);
+    }
+
+    static const size_t ncs[] = {512, 1024, 2048, 4096};
+    base = best;
+    for (size_t i = 0; i < sizeof(ncs) / sizeof(ncs[0]); i++) {
+        GemmConfig candidate = base;
+        candidate.nc = ncs[i];
+        try_config(a, b, c, &best, &best_time, candidate);
+    }
+
+    // Small problems can lose more to thread start-up than they gain
+    base = best;
+    for (size_t threads = 1; threads < parallel_num_threads(); threads *= 2) {
+        GemmConfig candidate = base;
+        candidate.threads = threads;
+        try_config(a, b, c, &best, &best_time, candidate);
+    }
+
+    printf("Tuned %zux%zux%zu: mc=%zu kc=%zu nc=%zu kernel=%zux%zu threads=%zu (%.3f ms)\n",
+           m, n, k, best.mc, best.kc, best.nc, best.mr, best.nr, best.threads, best_time * 1e3);
+
+    pthread_once(&load_once, load_default_cache);
+    pthread_mutex_lock(&entries_lock);
+    store_entry(autotune_cpu_model(), shape_bucket(m), shape_bucket(n), shape_bucket(k), &best);
+    pthread_mutex_unlock(&entries_lock);
+
+    mdarray_free(a);
+    mdarray_free(b);
+    mdarray_free(c);
+    return best;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "gemm.h"
+
+// Overrides the tuning cache location (default ~/.cache/nnc/gemm_tuning.tsv)
+#define AUTOTUNE_CACHE_ENV "NNC_TUNE_CACHE"
+#define AUTOTUNE_MAX_ENTRIES 256
+
+// Benchmarks never use dimensions larger than this, so tuning stays fast
+#define AUTOTUNE_MAX_DIM 4096
+
+// Tuned configuration for the shape class of (m, n, k) on this CPU, or the
+// default configuration if that class was never tuned. The first call
+// loads the on-disk cache.
+GemmConfig autotune_lookup(size_t m, size_t n, size_t k);
+
+// Benchmark candidate configurations for C[m, n] = A[m, k] * B[k, n],
+// remember the fastest for the shape class and return it. Call
+// autotune_save to persist the results.
+GemmConfig autotune_gemm(size_t m, size_t n, size_t k);
+
+int autotune_load(const char* path);
+int autotune_save(const char* path);
+const char* autotune_cache_path(void);
+const char* autotune_cpu_model(void);
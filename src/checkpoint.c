@@ -0,0 +1,235 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+_Static_assert(sizeof(CheckpointHeader) == 64, "checkpoint header must stay 64 bytes");
+_Static_assert(sizeof(CheckpointEntry) == 128, "checkpoint entry must stay 128 bytes");
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t align_up(uint64_t offset) {
+    return (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+// Writes size bytes and folds them into the checksum
+static int write_hashed(FILE* file, const void* data, size_t size, uint64_t* hash) {
+    *hash = fnv1a(*hash, data, size);
+    return fwrite(data, 1, size, file) == size ? 0 : -1;
+}
+
+static int write_padding(FILE* file, uint64_t* position, uint64_t* hash) {
+    static const unsigned char zeros[CHECKPOINT_ALIGNMENT];
+    size_t padding = (size_t)(align_up(*position) - *position);
+    *position += padding;
+    return write_hashed(file, zeros, padding, hash);
+}
+
+int checkpoint_save(const char* path, const CheckpointTensor* tensors, size_t n_tensors) {
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.n_tensors = (uint32_t)n_tensors;
+
+    CheckpointEntry* entries = (CheckpointEntry*)calloc(n_tensors ? n_tensors : 1, sizeof(CheckpointEntry));
+    MDArray** packed = (MDArray**)calloc(n_tensors ? n_tensors : 1, sizeof(MDArray*));
+    if (!entries || !packed) {
+        free(entries);
+        free(packed);
+        return -1;
+    }
+
+    // Lay out the table, then every payload on its own aligned offset
+    int status = 0;
+    uint64_t offset = sizeof(CheckpointHeader) + n_tensors * sizeof(CheckpointEntry);
+    for (size_t i = 0; i < n_tensors && status == 0; i++) {
+        MDArray* arr = tensors[i].array;
+        if (strlen(tensors[i].name) >= CHECKPOINT_MAX_NAME || arr->ndim > CHECKPOINT_MAX_DIMS ||
+            arr->itemsize != sizeof(double)) {
+            printf("Cannot checkpoint tensor %s\n", tensors[i].name);
+            status = -1;
+            break;
+        }
+
+        packed[i] = mdarray_contiguous(arr);
+        if (!packed[i]) {
+            status = -1;
+            break;
+        }
+
+        CheckpointEntry* e = &entries[i];
+        strcpy(e->name, tensors[i].name);
+        e->dtype = CHECKPOINT_F64;
+        e->ndim = (uint32_t)arr->ndim;
+        for (size_t d = 0; d < arr->ndim; d++) e->shape[d] = arr->shape[d];
+        e->offset = align_up(offset);
+        e->nbytes = arr->total_size * arr->itemsize;
+        offset = e->offset + e->nbytes;
+    }
+    header.file_size = offset;
+
+    // Unique per process so concurrent writers don't share a temporary
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long)getpid());
+    FILE* file = status == 0 ? fopen(tmp_path, "wb") : NULL;
+    if (status == 0 && !file) {
+        perror("Error opening checkpoint");
+        status = -1;
+    }
+
+    if (status == 0) {
+        // Header goes first with a zero checksum and is rewritten at the end
+        uint64_t hash = FNV_OFFSET;
+        uint64_t position = sizeof(CheckpointHeader) + n_tensors * sizeof(CheckpointEntry);
+        status |= fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+        status |= write_hashed(file, entries, n_tensors * sizeof(CheckpointEntry), &hash);
+        for (size_t i = 0; i < n_tensors && status == 0; i++) {
+            status |= write_padding(file, &position, &hash);
+            status |= write_hashed(file, packed[i]->data, entries[i].nbytes, &hash);
+            position += entries[i].nbytes;
+        }
+
+        header.checksum = hash;
+        status |= fseek(file, 0, SEEK_SET);
+        status |= fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+        status |= fflush(file);
+        status |= fsync(fileno(file));
+        status |= fclose(file);
+        if (status == 0 && rename(tmp_path, path) != 0) status = -1;
+        if (status != 0) {
+            perror("Error writing checkpoint");
+            unlink(tmp_path);
+        }
+    }
+
+    for (size_t i = 0; i < n_tensors; i++) mdarray_free(packed[i]);
+    free(packed);
+    free(entries);
+    return status;
+}
+
+static void checkpoint_unmap(void* ctx, void* data, size_t bytes) {
+    (void)ctx;
+    munmap(data, bytes);
+}
+
+static int checkpoint_validate(const char* path, const unsigned char* data, size_t size, int flags) {
+    const CheckpointHeader* header = (const CheckpointHeader*)data;
+    if (size < sizeof(CheckpointHeader) || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        printf("%s is not a checkpoint\n", path);
+        return -1;
+    }
+    if (header->version != CHECKPOINT_VERSION) {
+        printf("%s has checkpoint version %u, expected %d\n", path, header->version, CHECKPOINT_VERSION);
+        return -1;
+    }
+    if (header->file_size != size ||
+        header->n_tensors > (size - sizeof(CheckpointHeader)) / sizeof(CheckpointEntry)) {
+        printf("%s is truncated\n", path);
+        return -1;
+    }
+
+    const CheckpointEntry* entries = (const CheckpointEntry*)(data + sizeof(CheckpointHeader));
+    for (size_t i = 0; i < header->n_tensors; i++) {
+        const CheckpointEntry* e = &entries[i];
+        // A product wrapping past 64 bits could match a small nbytes
+        uint64_t elements = 1;
+        int overflow = 0;
+        for (size_t d = 0; d < e->ndim && d < CHECKPOINT_MAX_DIMS; d++) {
+            if (e->shape[d] && elements > UINT64_MAX / sizeof(double) / e->shape[d]) overflow = 1;
+            elements *= e->shape[d];
+        }
+
+        if (overflow || memchr(e->name, '\0', CHECKPOINT_MAX_NAME) == NULL || e->dtype != CHECKPOINT_F64 ||
+            e->ndim > CHECKPOINT_MAX_DIMS || e->offset % CHECKPOINT_ALIGNMENT != 0 ||
+            e->nbytes != elements * sizeof(double) || e->offset > size || e->nbytes > size - e->offset) {
+            printf("%s has an invalid tensor entry %zu\n", path, i);
+            return -1;
+        }
+    }
+
+    if (!(flags & CHECKPOINT_SKIP_CHECKSUM) &&
+        fnv1a(FNV_OFFSET, data + sizeof(CheckpointHeader), size - sizeof(CheckpointHeader)) != header->checksum) {
+        printf("%s failed its checksum\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+Checkpoint* checkpoint_open(const char* path, int flags) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening checkpoint");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CheckpointHeader)) {
+        printf("%s is not a checkpoint\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // Shared and read-only: every process maps the same page-cache pages
+    size_t size = (size_t)st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mapping checkpoint");
+        return NULL;
+    }
+
+    Checkpoint* checkpoint = (Checkpoint*)malloc(sizeof(Checkpoint));
+    MDBuffer* mapping = checkpoint ? mdbuffer_wrap(data, size, checkpoint_unmap, NULL) : NULL;
+    if (!mapping || checkpoint_validate(path, (const unsigned char*)data, size, flags) != 0) {
+        if (mapping) mdbuffer_release(mapping);
+        else munmap(data, size);
+        free(checkpoint);
+        return NULL;
+    }
+    mapping->readonly = 1;
+
+    checkpoint->mapping = mapping;
+    checkpoint->entries = (const CheckpointEntry*)((const char*)data + sizeof(CheckpointHeader));
+    checkpoint->n_tensors = ((const CheckpointHeader*)data)->n_tensors;
+
+    return checkpoint;
+}
+
+void checkpoint_close(Checkpoint* checkpoint) {
+    if (checkpoint) {
+        mdbuffer_release(checkpoint->mapping);
+        free(checkpoint);
+    }
+}
+
+MDArray* checkpoint_get(Checkpoint* checkpoint, const char* name) {
+    for (size_t i = 0; i < checkpoint->n_tensors; i++) {
+        const CheckpointEntry* e = &checkpoint->entries[i];
+        if (strcmp(e->name, name) != 0) continue;
+
+        size_t shape[CHECKPOINT_MAX_DIMS];
+        for (size_t d = 0; d < e->ndim; d++) shape[d] = (size_t)e->shape[d];
+        return mdarray_from_buffer(checkpoint->mapping, (size_t)e->offset, e->ndim, shape, NULL, sizeof(double));
+    }
+
+    printf("Checkpoint has no tensor %s\n", name);
+    return NULL;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mdarray.h"
+
+// File layout, native byte order, version 1:
+//   CheckpointHeader                      64 bytes
+//   CheckpointEntry[n_tensors]           128 bytes each
+//   payloads, each starting on a CHECKPOINT_ALIGNMENT boundary
+// The checksum is FNV-1a 64 over everything after the header.
+#define CHECKPOINT_MAGIC "NNCCKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_ALIGNMENT 64
+#define CHECKPOINT_MAX_NAME 64
+#define CHECKPOINT_MAX_DIMS 4
+
+// Skip the checksum pass in checkpoint_open, e.g. for a trusted file
+// whose pages should only be touched when used
+#define CHECKPOINT_SKIP_CHECKSUM 1
+
+typedef enum {
+    CHECKPOINT_F64 = 1
+} CheckpointDtype;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_tensors;
+    uint64_t file_size;
+    uint64_t checksum;
+    uint8_t reserved[32];
+} CheckpointHeader;
+
+typedef struct {
+    char name[CHECKPOINT_MAX_NAME];     // NUL-terminated
+    uint32_t dtype;
+    uint32_t ndim;
+    uint64_t shape[CHECKPOINT_MAX_DIMS];
+    uint64_t offset;                    // From the start of the file
+    uint64_t nbytes;
+    uint8_t reserved[8];
+} CheckpointEntry;
+
+typedef struct {
+    const char* name;
+    MDArray* array;
+} CheckpointTensor;
+
+// A mapped checkpoint. Views handed out by checkpoint_get hold their own
+// reference to the mapping, so they stay valid after checkpoint_close.
+typedef struct {
+    MDBuffer* mapping;
+    const CheckpointEntry* entries;
+    size_t n_tensors;
+} Checkpoint;
+
+// Writes a temporary file next to path and renames it over path, so
+// readers see either the old or the new checkpoint. Returns 0 on success.
+int checkpoint_save(const char* path, const CheckpointTensor* tensors, size_t n_tensors);
+
+// Maps path read-only and shared: processes opening the same file share
+// one page-cache copy. Returns NULL if the file is missing or invalid.
+Checkpoint* checkpoint_open(const char* path, int flags);
+void checkpoint_close(Checkpoint* checkpoint);
+
+// Zero-copy view of a tensor on the read-only mapping, NULL if absent.
+// Writing goes through mdarray_make_writable, which copies first.
+MDArray* checkpoint_get(Checkpoint* checkpoint, const char* name);
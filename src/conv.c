@@ -0,0 +1,468 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "conv.h"
+#include "gemm.h"
+#include "parallel.h"
+
+// Dimensions of one convolution call
+typedef struct {
+    size_t n, h, w, c_in;
+    size_t out_h, out_w, c_out;
+    size_t k, stride, padding;
+    size_t patch;   // k * k * c_in, one im2col row
+} ConvShape;
+
+typedef struct {
+    Conv2DLayer* layer;
+    ConvShape s;
+    const double* input;
+    const double* grad_output;
+    double* output;
+    double* grad_input;
+    double* grad_weights;       // Shared [patch, c_out] sum of all chunks
+    pthread_mutex_t lock;       // Guards grad_weights
+} ConvTask;
+
+Conv2DLayer* conv2d_create(size_t in_channels, size_t out_channels, size_t kernel_size,
+                           size_t stride, size_t padding) {
+    Conv2DLayer* layer = malloc(sizeof(Conv2DLayer));
+    if (!layer) return NULL;
+
+    layer->input = NULL;
+    layer->grad_weights = NULL;
+    layer->grad_biases = NULL;
+    layer->accumulate = 0;
+    layer->stride = stride ? stride : 1;
+    layer->padding = padding;
+    layer->algorithm = CONV_ALGO_AUTO;
+
+    size_t weights_shape[] = {kernel_size, kernel_size, in_channels, out_channels};
+    layer->weights = mdarray_create(4, weights_shape, sizeof(double));
+    if (!layer->weights) {
+        free(layer);
+        return NULL;
+    }
+    mdarray_zeros(layer->weights);
+
+    size_t biases_shape[] = {out_channels};
+    layer->biases = mdarray_create(1, biases_shape, sizeof(double));
+    if (!layer->biases) {
+        mdarray_free(layer->weights);
+        free(layer);
+        return NULL;
+    }
+    mdarray_zeros(layer->biases);
+
+    return layer;
+}
+
+void conv2d_free(Conv2DLayer* layer) {
+    if (layer) {
+        mdarray_free(layer->input);
+        mdarray_free(layer->weights);
+        mdarray_free(layer->biases);
+        mdarray_free(layer->grad_weights);
+        mdarray_free(layer->grad_biases);
+        free(layer);
+    }
+}
+
+// He initialization, fan-in is the number of weights per output channel
+void conv2d_init_he(Conv2DLayer* layer, RNG* rng) {
+    size_t* shape = layer->weights->shape;
+    double fan_in = (double)(shape[0] * shape[1] * shape[2]);
+
+    rng_truncated_normal(rng, layer->weights, 0.0, sqrt(2.0 / fan_in) / RNG_TRUNCATED_STDDEV);
+    mdarray_zeros(layer->biases);
+}
+
+ConvAlgorithm conv2d_select_algorithm(Conv2DLayer* layer) {
+    if (layer->algorithm != CONV_ALGO_AUTO) return layer->algorithm;
+
+    size_t* shape = layer->weights->shape;
+    size_t patch = shape[0] * shape[1] * shape[2];
+    return patch <= CONV_DIRECT_MAX_PATCH ? CONV_ALGO_DIRECT : CONV_ALGO_IM2COL;
+}
+
+static int conv_shape(Conv2DLayer* layer, MDArray* input, ConvShape* s) {
+    if (input->ndim != 4) {
+        printf("Conv2D input must be NHWC (4 dimensions)\n");
+        return -1;
+    }
+
+    s->n = input->shape[0];
+    s->h = input->shape[1];
+    s->w = input->shape[2];
+    s->c_in = input->shape[3];
+    s->k = layer->weights->shape[0];
+    s->c_out = layer->weights->shape[3];
+    s->stride = layer->stride;
+    s->padding = layer->padding;
+    s->patch = s->k * s->k * s->c_in;
+
+    if (s->c_in != layer->weights->shape[2]) {
+        printf("Input channels (%zu) different than weights channels (%zu)\n", s->c_in, layer->weights->shape[2]);
+        return -1;
+    }
+    if (s->h + 2 * s->padding < s->k || s->w + 2 * s->padding < s->k) {
+        printf("Conv2D kernel larger than padded input\n");
+        return -1;
+    }
+
+    s->out_h = (s->h + 2 * s->padding - s->k) / s->stride + 1;
+    s->out_w = (s->w + 2 * s->padding - s->k) / s->stride + 1;
+    return 0;
+}
+
+// Input row/column read by output position o and kernel offset kk, or -1
+// when it falls into the zero padding
+static long conv_input_pos(const ConvShape* s, size_t o, size_t kk, size_t size) {
+    long pos = (long)(o * s->stride + kk) - (long)s->padding;
+    return pos >= 0 && pos < (long)size ? pos : -1;
+}
+
+// Direct kernel: each task owns one image and one block of output channels.
+// The innermost loop runs over contiguous output channels of the HWIO
+// weights so it vectorizes.
+static void conv_direct_forward(void* ctx, size_t begin, size_t end) {
+    ConvTask* t = (ConvTask*)ctx;
+    const ConvShape* s = &t->s;
+    const double* weights = (const double*)t->layer->weights->data;
+    const double* biases = (const double*)t->layer->biases->data;
+    size_t n_blocks = (s->c_out + CONV_COUT_BLOCK - 1) / CONV_COUT_BLOCK;
+
+    for (size_t task = begin; task < end; task++) {
+        size_t n = task / n_blocks;
+        size_t co0 = (task % n_blocks) * CONV_COUT_BLOCK;
+        size_t nco = s->c_out - co0 < CONV_COUT_BLOCK ? s->c_out - co0 : CONV_COUT_BLOCK;
+
+        for (size_t oh = 0; oh < s->out_h; oh++) {
+            for (size_t ow = 0; ow < s->out_w; ow++) {
+                double acc[CONV_COUT_BLOCK];
+                for (size_t co = 0; co < nco; co++) acc[co] = biases[co0 + co];
+
+                for (size_t kh = 0; kh < s->k; kh++) {
+                    long ih = conv_input_pos(s, oh, kh, s->h);
+                    if (ih < 0) continue;
+                    for (size_t kw = 0; kw < s->k; kw++) {
+                        long iw = conv_input_pos(s, ow, kw, s->w);
+                        if (iw < 0) continue;
+
+                        const double* x = &t->input[((n * s->h + ih) * s->w + iw) * s->c_in];
+                        const double* w = &weights[(kh * s->k + kw) * s->c_in * s->c_out + co0];
+                        for (size_t ci = 0; ci < s->c_in; ci++) {
+                            double xv = x[ci];
+                            const double* wr = &w[ci * s->c_out];
+                            for (size_t co = 0; co < nco; co++) acc[co] += xv * wr[co];
+                        }
+                    }
+                }
+
+                double* out = &t->output[((n * s->out_h + oh) * s->out_w + ow) * s->c_out + co0];
+                for (size_t co = 0; co < nco; co++) out[co] = acc[co];
+            }
+        }
+    }
+}
+
+// Unfold image n into cols [out_h * out_w, patch], one receptive field per row
+static void conv_im2col(const ConvShape* s, const double* input, size_t n, double* cols) {
+    for (size_t oh = 0; oh < s->out_h; oh++) {
+        for (size_t ow = 0; ow < s->out_w; ow++) {
+            double* row = &cols[(oh * s->out_w + ow) * s->patch];
+            for (size_t kh = 0; kh < s->k; kh++) {
+                long ih = conv_input_pos(s, oh, kh, s->h);
+                for (size_t kw = 0; kw < s->k; kw++) {
+                    long iw = conv_input_pos(s, ow, kw, s->w);
+                    double* dst = &row[(kh * s->k + kw) * s->c_in];
+                    if (ih < 0 || iw < 0) {
+                        memset(dst, 0, s->c_in * sizeof(double));
+                    } else {
+                        memcpy(dst, &input[((n * s->h + ih) * s->w + iw) * s->c_in], s->c_in * sizeof(double));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Fold cols back into image n of grad_input, summing overlapping fields
+static void conv_col2im(const ConvShape* s, const double* cols, size_t n, double* grad_input) {
+    for (size_t oh = 0; oh < s->out_h; oh++) {
+        for (size_t ow = 0; ow < s->out_w; ow++) {
+            const double* row = &cols[(oh * s->out_w + ow) * s->patch];
+            for (size_t kh = 0; kh < s->k; kh++) {
+                long ih = conv_input_pos(s, oh, kh, s->h);
+                if (ih < 0) continue;
+                for (size_t kw = 0; kw < s->k; kw++) {
+                    long iw = conv_input_pos(s, ow, kw, s->w);
+                    if (iw < 0) continue;
+                    const double* src = &row[(kh * s->k + kw) * s->c_in];
+                    double* dst = &grad_input[((n * s->h + ih) * s->w + iw) * s->c_in];
+                    for (size_t ci = 0; ci < s->c_in; ci++) dst[ci] += src[ci];
+                }
+            }
+        }
+    }
+}
+
+// The batch is already split across threads, so each GEMM stays on one
+static GemmConfig conv_gemm_config(void) {
+    GemmConfig config = gemm_default_config();
+    config.threads = 1;
+    return config;
+}
+
+// im2col + GEMM: out_img [out_h * out_w, c_out] = cols * weights [patch, c_out]
+static void conv_im2col_forward(void* ctx, size_t begin, size_t end) {
+    ConvTask* t = (ConvTask*)ctx;
+    const ConvShape* s = &t->s;
+    const double* weights = (const double*)t->layer->weights->data;
+    const double* biases = (const double*)t->layer->biases->data;
+    size_t rows = s->out_h * s->out_w;
+    size_t cols_bytes = rows * s->patch * sizeof(double);
+    GemmConfig config = conv_gemm_config();
+
+    // Without room to unfold, the direct kernel computes the same images
+    double* cols = (double*)allocator_alloc(cols_bytes);
+    if (!cols) {
+        size_t n_blocks = (s->c_out + CONV_COUT_BLOCK - 1) / CONV_COUT_BLOCK;
+        conv_direct_forward(ctx, begin * n_blocks, end * n_blocks);
+        return;
+    }
+
+    for (size_t n = begin; n < end; n++) {
+        double* out = &t->output[n * rows * s->c_out];
+        for (size_t r = 0; r < rows; r++) {
+            memcpy(&out[r * s->c_out], biases, s->c_out * sizeof(double));
+        }
+
+        conv_im2col(s, t->input, n, cols);
+        gemm_dgemm(rows, s->c_out, s->patch, cols, s->patch, 1, weights, s->c_out, 1,
+                   out, s->c_out, 1, 1, &config);
+    }
+
+    allocator_free(cols, cols_bytes);
+}
+
+MDArray* conv2d_forward(Conv2DLayer* layer, MDArray* input) {
+    ConvTask t;
+    if (conv_shape(layer, input, &t.s) != 0) return NULL;
+
+    if (mdarray_save_contiguous(&layer->input, input) != 0) return NULL;
+
+    size_t out_shape[] = {t.s.n, t.s.out_h, t.s.out_w, t.s.c_out};
+    MDArray* out = mdarray_create(4, out_shape, sizeof(double));
+    if (!out) return NULL;
+
+    t.layer = layer;
+    t.input = (const double*)layer->input->data;
+    t.output = (double*)out->data;
+
+    if (conv2d_select_algorithm(layer) == CONV_ALGO_DIRECT) {
+        size_t n_blocks = (t.s.c_out + CONV_COUT_BLOCK - 1) / CONV_COUT_BLOCK;
+        parallel_for(t.s.n * n_blocks, 1, conv_direct_forward, &t);
+    } else {
+        parallel_for(t.s.n, 1, conv_im2col_forward, &t);
+    }
+
+    return out;
+}
+
+static void conv_add_grad_weights(ConvTask* t, const double* partial) {
+    size_t size = t->s.patch * t->s.c_out;
+    pthread_mutex_lock(&t->lock);
+    for (size_t i = 0; i < size; i++) t->grad_weights[i] += partial[i];
+    pthread_mutex_unlock(&t->lock);
+}
+
+// Direct backward over images [begin, end), weight gradients summed into dw
+static void conv_direct_backward_images(ConvTask* t, size_t begin, size_t end, double* dw) {
+    const ConvShape* s = &t->s;
+    const double* weights = (const double*)t->layer->weights->data;
+
+    for (size_t n = begin; n < end; n++) {
+        for (size_t oh = 0; oh < s->out_h; oh++) {
+            for (size_t ow = 0; ow < s->out_w; ow++) {
+                const double* dy = &t->grad_output[((n * s->out_h + oh) * s->out_w + ow) * s->c_out];
+
+                for (size_t kh = 0; kh < s->k; kh++) {
+                    long ih = conv_input_pos(s, oh, kh, s->h);
+                    if (ih < 0) continue;
+                    for (size_t kw = 0; kw < s->k; kw++) {
+                        long iw = conv_input_pos(s, ow, kw, s->w);
+                        if (iw < 0) continue;
+
+                        size_t pixel = ((n * s->h + ih) * s->w + iw) * s->c_in;
+                        const double* x = &t->input[pixel];
+                        double* dx = &t->grad_input[pixel];
+                        size_t w_offset = (kh * s->k + kw) * s->c_in * s->c_out;
+
+                        for (size_t ci = 0; ci < s->c_in; ci++) {
+                            const double* wr = &weights[w_offset + ci * s->c_out];
+                            double* dwr = &dw[w_offset + ci * s->c_out];
+                            double xv = x[ci];
+                            double g = 0.0;
+                            for (size_t co = 0; co < s->c_out; co++) {
+                                dwr[co] += xv * dy[co];
+                                g += wr[co] * dy[co];
+                            }
+                            dx[ci] += g;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Direct backward task: weight gradients go into a private partial that is merged once, input
+// gradients are per image. Without a partial the images are summed straight
+// into the shared gradients, holding the lock for the whole range.
+static void conv_direct_backward(void* ctx, size_t begin, size_t end) {
+    ConvTask* t = (ConvTask*)ctx;
+    size_t partial_bytes = t->s.patch * t->s.c_out * sizeof(double);
+
+    double* partial = (double*)allocator_alloc(partial_bytes);
+    if (!partial) {
+        pthread_mutex_lock(&t->lock);
+        conv_direct_backward_images(t, begin, end, t->grad_weights);
+        pthread_mutex_unlock(&t->lock);
+        return;
+    }
+    memset(partial, 0, partial_bytes);
+
+    conv_direct_backward_images(t, begin, end, partial);
+    conv_add_grad_weights(t, partial);
+    allocator_free(partial, partial_bytes);
+}
+
+// im2col backward over images [begin, end):
+//   partial dW [patch, c_out] += cols^T * dY_img
+//   dcols [rows, patch] = dY_img * W^T, folded back with col2im
+static void conv_im2col_backward(void* ctx, size_t begin, size_t end) {
+    ConvTask* t = (ConvTask*)ctx;
+    const ConvShape* s = &t->s;
+    const double* weights = (const double*)t->layer->weights->data;
+    size_t rows = s->out_h * s->out_w;
+    size_t cols_bytes = rows * s->patch * sizeof(double);
+    size_t partial_bytes = s->patch * s->c_out * sizeof(double);
+    GemmConfig config = conv_gemm_config();
+
+    double* cols = (double*)allocator_alloc(cols_bytes);
+    double* dcols = (double*)allocator_alloc(cols_bytes);
+    double* partial = (double*)allocator_alloc(partial_bytes);
+    if (!cols || !dcols || !partial) {
+        allocator_free(cols, cols_bytes);
+        allocator_free(dcols, cols_bytes);
+        allocator_free(partial, partial_bytes);
+        conv_direct_backward(ctx, begin, end);
+        return;
+    }
+    memset(partial, 0, partial_bytes);
+
+    for (size_t n = begin; n < end; n++) {
+        const double* dy = &t->grad_output[n * rows * s->c_out];
+
+        conv_im2col(s, t->input, n, cols);
+        gemm_dgemm(s->patch, s->c_out, rows, cols, 1, s->patch, dy, s->c_out, 1,
+                   partial, s->c_out, 1, 1, &config);
+        gemm_dgemm(rows, s->patch, s->c_out, dy, s->c_out, 1, weights, 1, s->c_out,
+                   dcols, s->patch, 1, 0, &config);
+        conv_col2im(s, dcols, n, t->grad_input);
+    }
+
+    conv_add_grad_weights(t, partial);
+    allocator_free(cols, cols_bytes);
+    allocator_free(dcols, cols_bytes);
+    allocator_free(partial, partial_bytes);
+}
+
+MDArray* conv2d_backward(Conv2DLayer* layer, MDArray* grad_output) {
+    ConvTask t;
+    if (!layer->input || conv_shape(layer, layer->input, &t.s) != 0) return NULL;
+
+    size_t out_shape[] = {t.s.n, t.s.out_h, t.s.out_w, t.s.c_out};
+    if (!mdarray_has_shape(grad_output, 4, out_shape)) {
+        printf("Conv2D gradient must match the last output [%zu, %zu, %zu, %zu]\n",
+               t.s.n, t.s.out_h, t.s.out_w, t.s.c_out);
+        return NULL;
+    }
+    MDArray* dy = mdarray_contiguous(grad_output);
+    if (!dy) return NULL;
+
+    // Accumulating adds to the gradients of earlier calls in place
+    int accumulate = layer->accumulate && layer->grad_weights && layer->grad_biases &&
+                     mdarray_make_writable(layer->grad_weights) == 0 &&
+                     mdarray_make_writable(layer->grad_biases) == 0;
+
+    MDArray* grad_input = mdarray_create(4, layer->input->shape, sizeof(double));
+    MDArray* grad_weights = accumulate ? layer->grad_weights : mdarray_create(4, layer->weights->shape, sizeof(double));
+    MDArray* grad_biases = accumulate ? layer->grad_biases : mdarray_create(1, layer->biases->shape, sizeof(double));
+    if (!grad_input || !grad_weights || !grad_biases) {
+        mdarray_free(grad_input);
+        if (!accumulate) {
+            mdarray_free(grad_weights);
+            mdarray_free(grad_biases);
+        }
+        mdarray_free(dy);
+        return NULL;
+    }
+    mdarray_zeros(grad_input);
+    if (!accumulate) {
+        mdarray_zeros(grad_weights);
+        mdarray_zeros(grad_biases);
+    }
+
+    t.layer = layer;
+    t.input = (const double*)layer->input->data;
+    t.grad_output = (const double*)dy->data;
+    t.grad_input = (double*)grad_input->data;
+    t.grad_weights = (double*)grad_weights->data;
+    pthread_mutex_init(&t.lock, NULL);
+
+    // Split the batch evenly so each thread builds one weight partial
+    size_t grain = (t.s.n + parallel_num_threads() - 1) / parallel_num_threads();
+    if (conv2d_select_algorithm(layer) == CONV_ALGO_DIRECT) {
+        parallel_for(t.s.n, grain, conv_direct_backward, &t);
+    } else {
+        parallel_for(t.s.n, grain, conv_im2col_backward, &t);
+    }
+    pthread_mutex_destroy(&t.lock);
+
+    // dL/db = sum of grad_output over batch and spatial positions
+    double* db = (double*)grad_biases->data;
+    size_t positions = t.s.n * t.s.out_h * t.s.out_w;
+    for (size_t p = 0; p < positions; p++) {
+        for (size_t co = 0; co < t.s.c_out; co++) {
+            db[co] += t.grad_output[p * t.s.c_out + co];
+        }
+    }
+    mdarray_free(dy);
+
+    if (!accumulate) {
+        mdarray_free(layer->grad_weights);
+        mdarray_free(layer->grad_biases);
+        layer->grad_weights = grad_weights;
+        layer->grad_biases = grad_biases;
+    }
+
+    return grad_input;
+}
+
+void conv2d_zero_grad(Conv2DLayer* layer) {
+    if (!layer->grad_weights) layer->grad_weights = mdarray_create(4, layer->weights->shape, sizeof(double));
+    if (!layer->grad_biases) layer->grad_biases = mdarray_create(1, layer->biases->shape, sizeof(double));
+    if (layer->grad_weights) mdarray_zeros(layer->grad_weights);
+    if (layer->grad_biases) mdarray_zeros(layer->grad_biases);
+}
+
+void conv2d_release_input(Conv2DLayer* layer) {
+    mdarray_free(layer->input);
+    layer->input = NULL;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "mdarray.h"
+#include "rng.h"
+
+// Filters with at most this many weights per output channel (kh * kw * c_in)
+// use the direct kernel, larger ones go through im2col + GEMM
+#define CONV_DIRECT_MAX_PATCH 64
+
+// Output channels computed together by one direct-kernel task
+#define CONV_COUT_BLOCK 16
+
+typedef enum {
+    CONV_ALGO_AUTO,
+    CONV_ALGO_DIRECT,
+    CONV_ALGO_IM2COL
+} ConvAlgorithm;
+
+// 2D convolution over NHWC activations
+typedef struct {
+    MDArray* weights;       // [kh, kw, c_in, c_out], c_out contiguous
+    MDArray* biases;        // [c_out]
+    MDArray* input;         // [n, h, w, c_in] saved for backward (holds a reference)
+    MDArray* grad_weights;
+    MDArray* grad_biases;
+    int accumulate;         // 1 to add backward's gradients to grad_weights and grad_biases
+    size_t stride;
+    size_t padding;         // Zero padding on each border
+    ConvAlgorithm algorithm;
+} Conv2DLayer;
+
+Conv2DLayer* conv2d_create(size_t in_channels, size_t out_channels, size_t kernel_size,
+                           size_t stride, size_t padding);
+void conv2d_free(Conv2DLayer* layer);
+void conv2d_init_he(Conv2DLayer* layer, RNG* rng);
+ConvAlgorithm conv2d_select_algorithm(Conv2DLayer* layer);
+
+// input   [n, h, w, c_in]
+// RETURNS [n, out_h, out_w, c_out]
+MDArray* conv2d_forward(Conv2DLayer* layer, MDArray* input);
+// grad_output [n, out_h, out_w, c_out]
+// RETURNS     [n, h, w, c_in], gradient with respect to the input
+MDArray* conv2d_backward(Conv2DLayer* layer, MDArray* grad_output);
+// Zeros grad_weights and grad_biases in place (see accumulate), allocating
+// them if no backward ran yet
+void conv2d_zero_grad(Conv2DLayer* layer);
+// Drops the input saved by the last forward
+void conv2d_release_input(Conv2DLayer* layer);
@@ -0,0 +1,259 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eval.h"
+#include "parallel.h"
+
+// Counts of one thread's chunks, merged into the result once at the end
+typedef struct {
+    size_t samples;
+    size_t correct;
+    double squared_error;
+    size_t confusion[EVAL_MAX_CLASSES][EVAL_MAX_CLASSES];
+    size_t* misclassified;
+    size_t n_misclassified;
+    int failed;
+} EvalPartial;
+
+typedef struct {
+    LinearLayer* layer;
+    size_t n_samples;
+    size_t chunk_size;
+    eval_fill_fn fill;
+    void* fill_ctx;
+    MDArray* labels;
+    const EvalConfig* config;
+    EvalResult* result;
+    double squared_error;
+    int failed;
+    pthread_mutex_t lock;
+} EvalTask;
+
+EvalConfig eval_default_config(void) {
+    EvalConfig config = {EVAL_CHUNK_SIZE, NULL, 0};
+    return config;
+}
+
+// Fused pass over the logits [classes, batch] of samples first..first+batch:
+// argmax, correct count, confusion and squared error against the one-hot
+// label, without materializing predictions or targets
+static void eval_score_chunk(EvalTask* t, const double* logits, size_t classes, size_t batch,
+                             size_t first, EvalPartial* p) {
+    const double* labels = (const double*)t->labels->data;
+    size_t label_stride = t->labels->strides[0];
+
+    for (size_t j = 0; j < batch; j++) {
+        size_t label = (size_t)labels[(first + j) * label_stride];
+        if (label >= classes) {
+            p->failed = 1;
+            continue;
+        }
+
+        size_t best = 0;
+        double best_value = logits[j];
+        double squared_error = 0.0;
+        for (size_t c = 0; c < classes; c++) {
+            double v = logits[c * batch + j];
+            if (v > best_value) {
+                best_value = v;
+                best = c;
+            }
+            double d = v - (c == label ? 1.0 : 0.0);
+            squared_error += d * d;
+        }
+
+        p->samples++;
+        p->squared_error += squared_error;
+        p->confusion[label][best]++;
+        if (best == label) {
+            p->correct++;
+        } else if (p->n_misclassified < t->config->max_misclassified) {
+            p->misclassified[p->n_misclassified++] = first + j;
+        }
+    }
+}
+
+// Both lists are sorted, keep the lowest max indices of their union
+static void eval_merge_misclassified(EvalTask* t, const EvalPartial* p) {
+    size_t max = t->config->max_misclassified;
+    size_t* out = t->config->misclassified;
+    size_t n_out = t->result->n_misclassified;
+    if (max == 0 || p->n_misclassified == 0) return;
+
+    size_t* merged = (size_t*)malloc(max * sizeof(size_t));
+    if (!merged) {
+        t->failed = 1;
+        return;
+    }
+
+    size_t i = 0, j = 0, n = 0;
+    while (n < max && (i < n_out || j < p->n_misclassified)) {
+        if (j == p->n_misclassified || (i < n_out && out[i] < p->misclassified[j])) {
+            merged[n++] = out[i++];
+        } else {
+            merged[n++] = p->misclassified[j++];
+        }
+    }
+    memcpy(out, merged, n * sizeof(size_t));
+    t->result->n_misclassified = n;
+    free(merged);
+}
+
+// Chunks [begin, end) through the layer, reusing input and logits throughout
+static void eval_chunks(EvalTask* t, size_t begin, size_t end, MDArray* input, MDArray* logits,
+                        EvalPartial* p) {
+    size_t classes = logits->shape[0];
+
+    for (size_t c = begin; c < end && !p->failed; c++) {
+        size_t first = c * t->chunk_size;
+        size_t batch = t->n_samples - first < t->chunk_size ? t->n_samples - first : t->chunk_size;
+
+        // The last chunk may be short, view the front of the same buffers
+        MDArray* chunk_input = input;
+        MDArray* chunk_logits = logits;
+        if (batch < t->chunk_size) {
+            size_t input_shape[] = {input->shape[0], batch};
+            size_t logits_shape[] = {classes, batch};
+            chunk_input = mdarray_from_buffer(input->buffer, 0, 2, input_shape, NULL, sizeof(double));
+            chunk_logits = mdarray_from_buffer(logits->buffer, 0, 2, logits_shape, NULL, sizeof(double));
+        }
+
+        if (!chunk_input || !chunk_logits) {
+            p->failed = 1;
+        } else {
+            t->fill(t->fill_ctx, first, first + batch, chunk_input);
+            if (linear_infer(t->layer, chunk_input, chunk_logits) != 0) {
+                p->failed = 1;
+            } else {
+                eval_score_chunk(t, (const double*)chunk_logits->data, classes, batch, first, p);
+            }
+        }
+
+        if (chunk_input != input) mdarray_free(chunk_input);
+        if (chunk_logits != logits) mdarray_free(chunk_logits);
+    }
+}
+
+// One thread's share of the chunks, with its own buffers and counts
+static void eval_range(void* ctx, size_t begin, size_t end) {
+    EvalTask* t = (EvalTask*)ctx;
+    size_t classes = t->layer->weights->shape[0];
+    size_t features = t->layer->weights->shape[1];
+    size_t max = t->config->max_misclassified;
+
+    EvalPartial* p = (EvalPartial*)calloc(1, sizeof(EvalPartial));
+    size_t input_shape[] = {features, t->chunk_size};
+    size_t logits_shape[] = {classes, t->chunk_size};
+    MDArray* input = mdarray_create(2, input_shape, sizeof(double));
+    MDArray* logits = mdarray_create(2, logits_shape, sizeof(double));
+    if (p && max) p->misclassified = (size_t*)malloc(max * sizeof(size_t));
+    int ready = p && input && logits && (!max || p->misclassified);
+
+    if (ready) eval_chunks(t, begin, end, input, logits, p);
+
+    pthread_mutex_lock(&t->lock);
+    if (ready) {
+        t->result->samples += p->samples;
+        t->result->correct += p->correct;
+        t->squared_error += p->squared_error;
+        for (size_t i = 0; i < classes; i++) {
+            for (size_t j = 0; j < classes; j++) t->result->confusion[i][j] += p->confusion[i][j];
+        }
+        eval_merge_misclassified(t, p);
+        t->failed |= p->failed;
+    } else {
+        t->failed = 1;
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    if (p) free(p->misclassified);
+    free(p);
+    mdarray_free(input);
+    mdarray_free(logits);
+}
+
+int eval_linear(LinearLayer* layer, size_t features, size_t n_samples, eval_fill_fn fill, void* fill_ctx,
+                MDArray* labels, const EvalConfig* config, EvalResult* result) {
+    EvalConfig defaults = eval_default_config();
+    if (!config) config = &defaults;
+
+    size_t classes = layer->weights->shape[0];
+    if (classes > EVAL_MAX_CLASSES) {
+        printf("Evaluation supports at most %d classes, layer has %zu\n", EVAL_MAX_CLASSES, classes);
+        return -1;
+    }
+    // The input chunks are sized by the layer, fill writes by the data
+    if (layer->weights->shape[1] != features) {
+        printf("Layer expects %zu input features, samples have %zu\n", layer->weights->shape[1], features);
+        return -1;
+    }
+    if (labels->ndim != 1 || labels->shape[0] < n_samples) {
+        printf("Labels must be a vector of at least %zu entries\n", n_samples);
+        return -1;
+    }
+
+    memset(result, 0, sizeof(EvalResult));
+    result->num_classes = classes;
+
+    EvalTask t;
+    t.layer = layer;
+    t.n_samples = n_samples;
+    t.chunk_size = config->chunk_size ? config->chunk_size : EVAL_CHUNK_SIZE;
+    t.fill = fill;
+    t.fill_ctx = fill_ctx;
+    t.labels = labels;
+    t.config = config;
+    t.result = result;
+    t.squared_error = 0.0;
+    t.failed = 0;
+    pthread_mutex_init(&t.lock, NULL);
+
+    size_t n_chunks = (n_samples + t.chunk_size - 1) / t.chunk_size;
+    parallel_for(n_chunks, 1, eval_range, &t);
+    pthread_mutex_destroy(&t.lock);
+
+    if (result->samples > 0) {
+        result->accuracy = (double)result->correct / (double)result->samples;
+        result->loss = t.squared_error / (double)(result->samples * classes);
+    }
+
+    return t.failed ? -1 : 0;
+}
+
+void eval_fill_sparse(void* ctx, size_t begin, size_t end, MDArray* batch) {
+    SparseMDArray* images = (SparseMDArray*)ctx;
+    double* data = (double*)batch->data;
+    size_t rs = batch->strides[0], cs = batch->strides[1];
+
+    mdarray_zeros(batch);
+    for (size_t j = begin; j < end; j++) {
+        for (size_t p = images->indptr[j]; p < images->indptr[j + 1]; p++) {
+            data[images->indices[p] * rs + (j - begin) * cs] = images->values[p];
+        }
+    }
+}
+
+void eval_fill_dense(void* ctx, size_t begin, size_t end, MDArray* batch) {
+    MDArray* images = (MDArray*)ctx;
+    const double* src = (const double*)images->data;
+    double* dst = (double*)batch->data;
+
+    for (size_t i = 0; i < batch->shape[0]; i++) {
+        for (size_t j = begin; j < end; j++) {
+            dst[i * batch->strides[0] + (j - begin) * batch->strides[1]] =
+                src[i * images->strides[0] + j * images->strides[1]];
+        }
+    }
+}
+
+void eval_print(const EvalResult* result) {
+    printf("Samples: %zu, correct: %zu, accuracy: %.2f%%, loss: %f\n",
+           result->samples, result->correct, 100.0 * result->accuracy, result->loss);
+    printf("Confusion matrix (rows are labels, columns are predictions):\n");
+    for (size_t i = 0; i < result->num_classes; i++) {
+        for (size_t j = 0; j < result->num_classes; j++) printf("%6zu", result->confusion[i][j]);
+        printf("\n");
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "linear.h"
+#include "sparse.h"
+
+// Samples per forward pass, matches a specialized kernel batch (kernels.def)
+#define EVAL_CHUNK_SIZE 64
+#define EVAL_MAX_CLASSES 16
+
+// Writes samples [begin, end) as the columns of batch [features, end - begin]
+typedef void (*eval_fill_fn)(void* ctx, size_t begin, size_t end, MDArray* batch);
+
+typedef struct {
+    size_t chunk_size;
+    size_t* misclassified;      // Optional, receives the lowest indices of wrong predictions
+    size_t max_misclassified;
+} EvalConfig;
+
+typedef struct {
+    size_t samples;
+    size_t correct;
+    double accuracy;
+    double loss;                // MSE against one-hot labels, as mse_loss over the whole set
+    size_t num_classes;
+    size_t confusion[EVAL_MAX_CLASSES][EVAL_MAX_CLASSES]; // [label][prediction]
+    size_t n_misclassified;     // Entries written to config->misclassified
+} EvalResult;
+
+EvalConfig eval_default_config(void);
+
+// Streams n_samples through layer in chunks, processed in parallel. Memory
+// stays at one input and one output chunk per thread regardless of
+// n_samples. fill writes features rows, which must be the layer's input
+// width. labels [n_samples] holds class indices. Returns 0 on success.
+int eval_linear(LinearLayer* layer, size_t features, size_t n_samples, eval_fill_fn fill, void* fill_ctx,
+                MDArray* labels, const EvalConfig* config, EvalResult* result);
+
+// Fill functions for a CSC SparseMDArray or a dense MDArray [features, N]
+void eval_fill_sparse(void* ctx, size_t begin, size_t end, MDArray* batch);
+void eval_fill_dense(void* ctx, size_t begin, size_t end, MDArray* batch);
+
+void eval_print(const EvalResult* result);
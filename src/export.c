@@ -0,0 +1,338 @@
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+
+#include "export.h"
+
+// A queued export. Slots are reused, their buffers only ever grow.
+typedef struct {
+    char path[EXPORT_MAX_PATH];     // File for a grid, prefix for single images
+    size_t columns;                 // 0 for one file per image
+    size_t n, h, w;
+    unsigned char* pixels;          // n images of h * w bytes
+    size_t pixels_capacity;
+    size_t* ids;                    // Sample index of each image, for file names
+    size_t ids_capacity;
+} ExportJob;
+
+// libjpeg's default error_exit ends the process. This one jumps back to
+// whoever is driving the compressor instead.
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} ExportError;
+
+struct Exporter {
+    ExportJob* jobs;                // Ring of queue_capacity slots
+    size_t capacity;
+    size_t head;                    // Oldest queued job
+    size_t count;
+    size_t dropped;
+    size_t failed;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t idle;
+    pthread_t thread;
+
+    // Only touched by the export thread
+    struct jpeg_compress_struct cinfo;
+    ExportError jerr;
+    unsigned char* scanline;        // One grid row
+    size_t scanline_capacity;
+};
+
+ExportConfig export_default_config(void) {
+    ExportConfig config = {EXPORT_QUEUE_CAPACITY, EXPORT_QUALITY};
+    return config;
+}
+
+static int grow(void** buffer, size_t* capacity, size_t bytes) {
+    if (bytes <= *capacity) return 0;
+
+    void* grown = realloc(*buffer, bytes);
+    if (!grown) return -1;
+    *buffer = grown;
+    *capacity = bytes;
+    return 0;
+}
+
+static void export_error_exit(j_common_ptr cinfo) {
+    ExportError* err = (ExportError*)cinfo->err;
+    err->pub.output_message(cinfo);
+    longjmp(err->jump, 1);
+}
+
+// Returns 0 once path is written, -1 if it could not be
+static int export_write(Exporter* exporter, const char* path, size_t width, size_t height,
+                        const ExportJob* job, const unsigned char* image) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        perror("Error opening export file");
+        return -1;
+    }
+
+    // A libjpeg error abandons this image, the compressor stays usable
+    struct jpeg_compress_struct* cinfo = &exporter->cinfo;
+    if (setjmp(exporter->jerr.jump)) {
+        jpeg_abort_compress(cinfo);
+        fclose(file);
+        printf("Failed to write %s\n", path);
+        return -1;
+    }
+
+    jpeg_stdio_dest(cinfo, file);
+    cinfo->image_width = (JDIMENSION)width;
+    cinfo->image_height = (JDIMENSION)height;
+    jpeg_start_compress(cinfo, TRUE);
+
+    while (cinfo->next_scanline < cinfo->image_height) {
+        size_t y = cinfo->next_scanline;
+        JSAMPROW row_pointer[1];
+        if (image) {
+            row_pointer[0] = (JSAMPROW)&image[y * width];
+        } else {
+            // Grid rows are assembled from one row of each tile, blank past the last image
+            size_t tile_row = y / job->h;
+            memset(exporter->scanline, 0, width);
+            for (size_t c = 0; c < job->columns; c++) {
+                size_t i = tile_row * job->columns + c;
+                if (i >= job->n) break;
+                memcpy(&exporter->scanline[c * job->w], &job->pixels[(i * job->h + y % job->h) * job->w], job->w);
+            }
+            row_pointer[0] = exporter->scanline;
+        }
+        jpeg_write_scanlines(cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_compress(cinfo);
+    if (fclose(file) != 0) {
+        perror("Error closing export file");
+        return -1;
+    }
+    return 0;
+}
+
+// Returns -1 if any of the job's files could not be written
+static int export_job(Exporter* exporter, const ExportJob* job) {
+    if (job->columns == 0) {
+        char path[EXPORT_MAX_PATH + 32];
+        int status = 0;
+        for (size_t i = 0; i < job->n; i++) {
+            snprintf(path, sizeof(path), "%s_%zu.jpeg", job->path, job->ids[i]);
+            if (export_write(exporter, path, job->w, job->h, job, &job->pixels[i * job->h * job->w]) != 0) {
+                status = -1;
+            }
+        }
+        return status;
+    }
+
+    size_t rows = (job->n + job->columns - 1) / job->columns;
+    size_t width = job->columns * job->w;
+    if (grow((void**)&exporter->scanline, &exporter->scanline_capacity, width) != 0) {
+        printf("Failed to allocate a scanline for %s\n", job->path);
+        return -1;
+    }
+    return export_write(exporter, job->path, width, rows * job->h, job, NULL);
+}
+
+static void* export_thread(void* arg) {
+    Exporter* exporter = (Exporter*)arg;
+
+    pthread_mutex_lock(&exporter->lock);
+    for (;;) {
+        while (exporter->count == 0 && !exporter->stop) {
+            pthread_cond_wait(&exporter->queued, &exporter->lock);
+        }
+        if (exporter->count == 0) break;
+
+        // The head slot stays counted while it is written, so no export reuses it
+        ExportJob* job = &exporter->jobs[exporter->head];
+        pthread_mutex_unlock(&exporter->lock);
+        int status = export_job(exporter, job);
+        pthread_mutex_lock(&exporter->lock);
+
+        if (status != 0) exporter->failed++;
+
+        exporter->head = (exporter->head + 1) % exporter->capacity;
+        exporter->count--;
+        if (exporter->count == 0) pthread_cond_broadcast(&exporter->idle);
+    }
+    pthread_mutex_unlock(&exporter->lock);
+
+    return NULL;
+}
+
+// One compressor for the lifetime of the exporter, only the dimensions
+// and destination change between images. Returns 0 on success.
+static int export_create_compressor(Exporter* exporter, int quality) {
+    struct jpeg_compress_struct* cinfo = &exporter->cinfo;
+    cinfo->err = jpeg_std_error(&exporter->jerr.pub);
+    exporter->jerr.pub.error_exit = export_error_exit;
+    if (setjmp(exporter->jerr.jump)) {
+        jpeg_destroy_compress(cinfo);
+        return -1;
+    }
+
+    jpeg_create_compress(cinfo);
+    cinfo->input_components = 1;
+    cinfo->in_color_space = JCS_GRAYSCALE;
+    jpeg_set_defaults(cinfo);
+    jpeg_set_quality(cinfo, quality, TRUE);
+    return 0;
+}
+
+Exporter* exporter_create(const ExportConfig* config) {
+    ExportConfig defaults = export_default_config();
+    if (!config) config = &defaults;
+
+    Exporter* exporter = (Exporter*)calloc(1, sizeof(Exporter));
+    if (!exporter) return NULL;
+
+    exporter->capacity = config->queue_capacity ? config->queue_capacity : 1;
+    exporter->jobs = (ExportJob*)calloc(exporter->capacity, sizeof(ExportJob));
+    if (!exporter->jobs) {
+        free(exporter);
+        return NULL;
+    }
+
+    if (export_create_compressor(exporter, config->quality) != 0) {
+        free(exporter->jobs);
+        free(exporter);
+        return NULL;
+    }
+
+    pthread_mutex_init(&exporter->lock, NULL);
+    pthread_cond_init(&exporter->queued, NULL);
+    pthread_cond_init(&exporter->idle, NULL);
+    if (pthread_create(&exporter->thread, NULL, export_thread, exporter) != 0) {
+        perror("Error starting export thread");
+        pthread_mutex_destroy(&exporter->lock);
+        pthread_cond_destroy(&exporter->queued);
+        pthread_cond_destroy(&exporter->idle);
+        jpeg_destroy_compress(&exporter->cinfo);
+        free(exporter->jobs);
+        free(exporter);
+        return NULL;
+    }
+
+    return exporter;
+}
+
+void exporter_free(Exporter* exporter) {
+    if (!exporter) return;
+
+    pthread_mutex_lock(&exporter->lock);
+    exporter->stop = 1;
+    pthread_cond_signal(&exporter->queued);
+    pthread_mutex_unlock(&exporter->lock);
+    pthread_join(exporter->thread, NULL);
+
+    pthread_mutex_destroy(&exporter->lock);
+    pthread_cond_destroy(&exporter->queued);
+    pthread_cond_destroy(&exporter->idle);
+    jpeg_destroy_compress(&exporter->cinfo);
+    for (size_t i = 0; i < exporter->capacity; i++) {
+        free(exporter->jobs[i].pixels);
+        free(exporter->jobs[i].ids);
+    }
+    free(exporter->jobs);
+    free(exporter->scanline);
+    free(exporter);
+}
+
+void exporter_flush(Exporter* exporter) {
+    pthread_mutex_lock(&exporter->lock);
+    while (exporter->count > 0) pthread_cond_wait(&exporter->idle, &exporter->lock);
+    pthread_mutex_unlock(&exporter->lock);
+}
+
+size_t exporter_dropped(Exporter* exporter) {
+    pthread_mutex_lock(&exporter->lock);
+    size_t dropped = exporter->dropped;
+    pthread_mutex_unlock(&exporter->lock);
+    return dropped;
+}
+
+size_t exporter_failed(Exporter* exporter) {
+    pthread_mutex_lock(&exporter->lock);
+    size_t failed = exporter->failed;
+    pthread_mutex_unlock(&exporter->lock);
+    return failed;
+}
+
+// Copies the selected images into the next free slot, rounded and clamped to bytes
+static int exporter_enqueue(Exporter* exporter, MDArray* images, const size_t* indices, size_t n,
+                            size_t columns, const char* path) {
+    if (images->ndim != 3 || n == 0 || strlen(path) >= EXPORT_MAX_PATH) {
+        printf("Export expects images [N, h, w] and a path below %d bytes\n", EXPORT_MAX_PATH);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if ((indices ? indices[i] : i) >= images->shape[0]) {
+            printf("Export index %zu out of %zu images\n", indices ? indices[i] : i, images->shape[0]);
+            return -1;
+        }
+    }
+
+    // JPEG caps both dimensions of the written image
+    size_t h = images->shape[1], w = images->shape[2];
+    size_t tiles_across = columns ? columns : 1;
+    size_t tiles_down = columns ? (n + columns - 1) / columns : 1;
+    if (h == 0 || w == 0 || w > JPEG_MAX_DIMENSION / tiles_across || h > JPEG_MAX_DIMENSION / tiles_down) {
+        printf("Export of %zu x %zu tiles of %zu x %zu pixels exceeds %ld pixels per side\n",
+               tiles_down, tiles_across, h, w, JPEG_MAX_DIMENSION);
+        return -1;
+    }
+
+    pthread_mutex_lock(&exporter->lock);
+    if (exporter->count == exporter->capacity) {
+        exporter->dropped++;
+        pthread_mutex_unlock(&exporter->lock);
+        return -1;
+    }
+
+    ExportJob* job = &exporter->jobs[(exporter->head + exporter->count) % exporter->capacity];
+    if (grow((void**)&job->pixels, &job->pixels_capacity, n * h * w) != 0 ||
+        grow((void**)&job->ids, &job->ids_capacity, n * sizeof(size_t)) != 0) {
+        exporter->dropped++;
+        pthread_mutex_unlock(&exporter->lock);
+        return -1;
+    }
+
+    strcpy(job->path, path);
+    job->columns = columns;
+    job->n = n;
+    job->h = h;
+    job->w = w;
+    const double* src = (const double*)images->data;
+    for (size_t i = 0; i < n; i++) {
+        size_t id = indices ? indices[i] : i;
+        job->ids[i] = id;
+        unsigned char* dst = &job->pixels[i * h * w];
+        for (size_t y = 0; y < h; y++) {
+            for (size_t x = 0; x < w; x++) {
+                double v = src[id * images->strides[0] + y * images->strides[1] + x * images->strides[2]];
+                dst[y * w + x] = (unsigned char)(v < 0.0 ? 0.0 : v > 255.0 ? 255.0 : v + 0.5);
+            }
+        }
+    }
+
+    exporter->count++;
+    pthread_cond_signal(&exporter->queued);
+    pthread_mutex_unlock(&exporter->lock);
+
+    return 0;
+}
+
+int exporter_images(Exporter* exporter, MDArray* images, const size_t* indices, size_t n, const char* prefix) {
+    return exporter_enqueue(exporter, images, indices, n, 0, prefix);
+}
+
+int exporter_grid(Exporter* exporter, MDArray* images, const size_t* indices, size_t n, size_t columns,
+                  const char* path) {
+    return exporter_enqueue(exporter, images, indices, n, columns ? columns : 1, path);
+}
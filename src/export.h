@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "mdarray.h"
+
+#define EXPORT_QUEUE_CAPACITY 8
+#define EXPORT_QUALITY 95
+#define EXPORT_MAX_PATH 256
+
+// Writes images as JPEG files on a background thread. Exports copy their
+// pixels into one of queue_capacity reusable slots and return right away.
+// When every slot is taken the export is dropped rather than waited for,
+// so diagnostics never hold up the caller. The thread reuses a single
+// libjpeg compressor and scanline buffer for everything it writes.
+typedef struct Exporter Exporter;
+
+typedef struct {
+    size_t queue_capacity;  // Exports waiting at most, further ones are dropped
+    int quality;            // libjpeg quality, 0-100
+} ExportConfig;
+
+ExportConfig export_default_config(void);
+
+Exporter* exporter_create(const ExportConfig* config);
+// Writes whatever is still queued, then stops the thread
+void exporter_free(Exporter* exporter);
+// Returns once every queued export has been written
+void exporter_flush(Exporter* exporter);
+size_t exporter_dropped(Exporter* exporter);
+// Exports that were queued but could not be written
+size_t exporter_failed(Exporter* exporter);
+
+// images [N, h, w] holds grayscale values in 0-255. indices selects n of
+// them, NULL means the first n. Both return 0 if queued, -1 if dropped or
+// if a written image would exceed JPEG's 65500 pixels per side.
+
+// One file per image, <prefix>_<index>.jpeg
+int exporter_images(Exporter* exporter, MDArray* images, const size_t* indices, size_t n, const char* prefix);
+// All n images in one file, tiled left to right in rows of columns
+int exporter_grid(Exporter* exporter, MDArray* images, const size_t* indices, size_t n, size_t columns,
+                  const char* path);
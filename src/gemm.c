@@ -0,0 +1,213 @@
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "gemm.h"
+#include "parallel.h"
+
+typedef void (*GemmKernel)(size_t kc, const double* ap, const double* bp,
+                           double* c, size_t rsc, size_t csc,
+                           size_t m, size_t n, int accumulate);
+
+typedef struct {
+    size_t m, n, k;
+    const double* a;
+    size_t rsa, csa;
+    const double* b;
+    size_t rsb, csb;
+    double* c;
+    size_t rsc, csc;
+    int accumulate;
+    GemmConfig config;
+    GemmKernel kernel;
+    size_t chunk_cols; // Columns of C per parallel chunk
+} GemmProblem;
+
+// Micro-kernels accumulate an MR x NR tile of C in registers from packed
+// slivers of A (MR rows, column-major) and B (NR columns, row-major). The
+// constant trip counts let the compiler fully unroll and vectorize them.
+#define GEMM_MICRO_KERNEL(MR, NR)                                                    \
+    static void gemm_kernel_##MR##x##NR(size_t kc, const double* ap, const double* bp, \
+                                        double* c, size_t rsc, size_t csc,            \
+                                        size_t m, size_t n, int accumulate) {         \
+        double acc[MR][NR] = {{0}};                                                   \
+        for (size_t p = 0; p < kc; p++) {                                             \
+            for (size_t i = 0; i < MR; i++) {                                         \
+                for (size_t j = 0; j < NR; j++) {                                     \
+                    acc[i][j] += ap[p * MR + i] * bp[p * NR + j];                     \
+                }                                                                     \
+            }                                                                         \
+        }                                                                             \
+        for (size_t i = 0; i < m; i++) {                                              \
+            for (size_t j = 0; j < n; j++) {                                          \
+                double* out = &c[i * rsc + j * csc];                                  \
+                *out = accumulate ? *out + acc[i][j] : acc[i][j];                     \
+            }                                                                         \
+        }                                                                             \
+    }
+
+GEMM_MICRO_KERNEL(4, 4)
+GEMM_MICRO_KERNEL(4, 8)
+GEMM_MICRO_KERNEL(8, 4)
+GEMM_MICRO_KERNEL(8, 8)
+
+static GemmKernel gemm_select_kernel(size_t mr, size_t nr) {
+    if (mr == 4 && nr == 4) return gemm_kernel_4x4;
+    if (mr == 4 && nr == 8) return gemm_kernel_4x8;
+    if (mr == 8 && nr == 4) return gemm_kernel_8x4;
+    if (mr == 8 && nr == 8) return gemm_kernel_8x8;
+    return NULL;
+}
+
+GemmConfig gemm_default_config(void) {
+    GemmConfig config = {128, 256, 2048, 4, 8, parallel_num_threads()};
+    return config;
+}
+
+int gemm_config_valid(const GemmConfig* config) {
+    return config->mc > 0 && config->kc > 0 && config->nc > 0 && config->threads > 0 &&
+           gemm_select_kernel(config->mr, config->nr) != NULL;
+}
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// Pack an mc x kc block of A into slivers of mr rows, zero-padding the last one
+static void gemm_pack_a(size_t mc, size_t kc, const double* a, size_t rsa, size_t csa,
+                        size_t mr, double* buf) {
+    for (size_t i0 = 0; i0 < mc; i0 += mr) {
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t i = 0; i < mr; i++) {
+                *buf++ = i0 + i < mc ? a[(i0 + i) * rsa + p * csa] : 0.0;
+            }
+        }
+    }
+}
+
+// Pack a kc x nc block of B into slivers of nr columns, zero-padding the last one
+static void gemm_pack_b(size_t kc, size_t nc, const double* b, size_t rsb, size_t csb,
+                        size_t nr, double* buf) {
+    for (size_t j0 = 0; j0 < nc; j0 += nr) {
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t j = 0; j < nr; j++) {
+                *buf++ = j0 + j < nc ? b[p * rsb + (j0 + j) * csb] : 0.0;
+            }
+        }
+    }
+}
+
+static void gemm_zero(GemmProblem* pr, size_t col_begin, size_t col_end) {
+    for (size_t i = 0; i < pr->m; i++) {
+        for (size_t j = col_begin; j < col_end; j++) {
+            pr->c[i * pr->rsc + j * pr->csc] = 0.0;
+        }
+    }
+}
+
+// Unpacked loop over columns [col_begin, col_end) of C, used when the
+// packing buffers cannot be allocated so C is still complete
+static void gemm_reference(GemmProblem* pr, size_t col_begin, size_t col_end) {
+    for (size_t i = 0; i < pr->m; i++) {
+        for (size_t j = col_begin; j < col_end; j++) {
+            double sum = 0.0;
+            for (size_t p = 0; p < pr->k; p++) {
+                sum += pr->a[i * pr->rsa + p * pr->csa] * pr->b[p * pr->rsb + j * pr->csb];
+            }
+            double* c = &pr->c[i * pr->rsc + j * pr->csc];
+            *c = pr->accumulate ? *c + sum : sum;
+        }
+    }
+}
+
+// Blocked GEMM over the columns of C covered by chunks [chunk_begin, chunk_end)
+static void gemm_chunks(void* ctx, size_t chunk_begin, size_t chunk_end) {
+    GemmProblem* pr = (GemmProblem*)ctx;
+    const GemmConfig* cfg = &pr->config;
+    size_t mr = cfg->mr;
+    size_t nr = cfg->nr;
+
+    size_t col_begin = chunk_begin * pr->chunk_cols;
+    size_t col_end = min_size(chunk_end * pr->chunk_cols, pr->n);
+    if (col_begin >= col_end) return;
+
+    if (pr->k == 0) {
+        if (!pr->accumulate) gemm_zero(pr, col_begin, col_end);
+        return;
+    }
+
+    size_t mc_max = min_size(cfg->mc, pr->m);
+    size_t kc_max = min_size(cfg->kc, pr->k);
+    size_t nc_max = min_size(cfg->nc, col_end - col_begin);
+    size_t a_bytes = ((mc_max + mr - 1) / mr) * mr * kc_max * sizeof(double);
+    size_t b_bytes = ((nc_max + nr - 1) / nr) * nr * kc_max * sizeof(double);
+    double* a_buf = (double*)allocator_alloc(a_bytes);
+    double* b_buf = (double*)allocator_alloc(b_bytes);
+    if (!a_buf || !b_buf) {
+        allocator_free(a_buf, a_bytes);
+        allocator_free(b_buf, b_bytes);
+        gemm_reference(pr, col_begin, col_end);
+        return;
+    }
+
+    for (size_t jc = col_begin; jc < col_end; jc += cfg->nc) {
+        size_t ncb = min_size(cfg->nc, col_end - jc);
+
+        for (size_t pc = 0; pc < pr->k; pc += cfg->kc) {
+            size_t kcb = min_size(cfg->kc, pr->k - pc);
+            // Later depth blocks add onto the partial sums of the first one
+            int accumulate = pr->accumulate || pc > 0;
+
+            gemm_pack_b(kcb, ncb, &pr->b[pc * pr->rsb + jc * pr->csb], pr->rsb, pr->csb, nr, b_buf);
+
+            for (size_t ic = 0; ic < pr->m; ic += cfg->mc) {
+                size_t mcb = min_size(cfg->mc, pr->m - ic);
+
+                gemm_pack_a(mcb, kcb, &pr->a[ic * pr->rsa + pc * pr->csa], pr->rsa, pr->csa, mr, a_buf);
+
+                for (size_t jr = 0; jr < ncb; jr += nr) {
+                    for (size_t ir = 0; ir < mcb; ir += mr) {
+                        double* c = &pr->c[(ic + ir) * pr->rsc + (jc + jr) * pr->csc];
+                        pr->kernel(kcb, &a_buf[ir * kcb], &b_buf[jr * kcb], c, pr->rsc, pr->csc,
+                                   min_size(mr, mcb - ir), min_size(nr, ncb - jr), accumulate);
+                    }
+                }
+            }
+        }
+    }
+
+    allocator_free(a_buf, a_bytes);
+    allocator_free(b_buf, b_bytes);
+}
+
+void gemm_dgemm(size_t m, size_t n, size_t k,
+                const double* a, size_t rsa, size_t csa,
+                const double* b, size_t rsb, size_t csb,
+                double* c, size_t rsc, size_t csc,
+                int accumulate, const GemmConfig* config) {
+    if (m == 0 || n == 0) return;
+
+    GemmProblem pr;
+    pr.m = m;
+    pr.n = n;
+    pr.k = k;
+    pr.a = a;
+    pr.rsa = rsa;
+    pr.csa = csa;
+    pr.b = b;
+    pr.rsb = rsb;
+    pr.csb = csb;
+    pr.c = c;
+    pr.rsc = rsc;
+    pr.csc = csc;
+    pr.accumulate = accumulate;
+    pr.config = config && gemm_config_valid(config) ? *config : gemm_default_config();
+    pr.kernel = gemm_select_kernel(pr.config.mr, pr.config.nr);
+
+    // Split C into column ranges that are whole multiples of nr
+    size_t threads = pr.config.threads;
+    size_t per_thread = (n + threads - 1) / threads;
+    pr.chunk_cols = (per_thread + pr.config.nr - 1) / pr.config.nr * pr.config.nr;
+    size_t n_chunks = (n + pr.chunk_cols - 1) / pr.chunk_cols;
+
+    parallel_for(n_chunks, 1, gemm_chunks, &pr);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+
+// Blocking parameters for gemm_dgemm
+typedef struct {
+    size_t mc;      // Rows of A packed per block (L2)
+    size_t kc;      // Depth of each packed panel (L1)
+    size_t nc;      // Columns of B packed per block (L3)
+    size_t mr;      // Micro-kernel rows, one of 4 or 8
+    size_t nr;      // Micro-kernel columns, one of 4 or 8
+    size_t threads; // Column ranges computed in parallel
+} GemmConfig;
+
+GemmConfig gemm_default_config(void);
+int gemm_config_valid(const GemmConfig* config);
+
+// C[m, n] = A[m, k] * B[k, n], or C += A * B when accumulate is 1.
+// Each matrix is given by its data pointer and row/column strides in
+// elements, so transposed views need no copy.
+void gemm_dgemm(size_t m, size_t n, size_t k,
+                const double* a, size_t rsa, size_t csa,
+                const double* b, size_t rsb, size_t csb,
+                double* c, size_t rsc, size_t csc,
+                int accumulate, const GemmConfig* config);
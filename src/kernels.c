@@ -0,0 +1,155 @@
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "kernels.h"
+
+// Path of the X-macro shape list, CMake passes the configured one
+#ifndef NNC_KERNEL_SHAPES
+#define NNC_KERNEL_SHAPES "kernels.def"
+#endif
+
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+static atomic_int kernels_enabled = 1;
+
+// The bodies below take the shape as arguments. Each KERNEL_SHAPE wrapper
+// inlines them with literal sizes, so every loop has a constant trip count
+// the compiler can fully unroll (out_features) and vectorize (batch).
+
+KERNEL_INLINE void kernel_forward(size_t in, size_t out, size_t batch,
+                                  const double* restrict w, const double* restrict b,
+                                  const double* restrict x, double* restrict y) {
+    for (size_t o = 0; o < out; o++) {
+        for (size_t j = 0; j < batch; j++) y[o * batch + j] = b[o];
+    }
+
+    // One pass over x, all outputs for a row of x accumulate together
+    for (size_t k = 0; k < in; k++) {
+        const double* xk = &x[k * batch];
+#pragma GCC unroll 16
+        for (size_t o = 0; o < out; o++) {
+            double wk = w[o * in + k];
+            for (size_t j = 0; j < batch; j++) y[o * batch + j] += wk * xk[j];
+        }
+    }
+}
+
+KERNEL_INLINE void kernel_backward_weights(size_t in, size_t out, size_t batch,
+                                           const double* restrict g, const double* restrict x,
+                                           double* restrict dw) {
+    // dW[o][k] = sum_j g[o][j] * x[k][j]
+    for (size_t k = 0; k < in; k++) {
+        const double* xk = &x[k * batch];
+#pragma GCC unroll 16
+        for (size_t o = 0; o < out; o++) {
+            double sum = 0.0;
+            for (size_t j = 0; j < batch; j++) sum += g[o * batch + j] * xk[j];
+            dw[o * in + k] = sum;
+        }
+    }
+}
+
+KERNEL_INLINE void kernel_backward_biases(size_t out, size_t batch,
+                                          const double* restrict g, double* restrict db) {
+#pragma GCC unroll 16
+    for (size_t o = 0; o < out; o++) {
+        double sum = 0.0;
+        for (size_t j = 0; j < batch; j++) sum += g[o * batch + j];
+        db[o] = sum;
+    }
+}
+
+KERNEL_INLINE void kernel_backward_input(size_t in, size_t out, size_t batch,
+                                         const double* restrict w, const double* restrict g,
+                                         double* restrict dx) {
+    // dX[k][j] = sum_o w[o][k] * g[o][j]
+    for (size_t k = 0; k < in; k++) {
+        double* dxk = &dx[k * batch];
+        for (size_t j = 0; j < batch; j++) dxk[j] = 0.0;
+#pragma GCC unroll 16
+        for (size_t o = 0; o < out; o++) {
+            double wk = w[o * in + k];
+            for (size_t j = 0; j < batch; j++) dxk[j] += wk * g[o * batch + j];
+        }
+    }
+}
+
+KERNEL_INLINE double kernel_mse_loss(size_t n, const double* restrict p, const double* restrict t) {
+    double loss = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double d = p[i] - t[i];
+        loss += d * d;
+    }
+    return loss / n;
+}
+
+KERNEL_INLINE void kernel_mse_gradient(size_t n, const double* restrict p, const double* restrict t,
+                                       double* restrict grad) {
+    double scale = 2.0 / n;
+    for (size_t i = 0; i < n; i++) grad[i] = scale * (p[i] - t[i]);
+}
+
+// Instantiate the kernels of every declared shape
+#define KERNEL_SHAPE(IN, OUT, BATCH) \
+    static void linear_forward_##IN##_##OUT##_##BATCH(const double* w, const double* b, \
+                                                      const double* x, double* y) { \
+        kernel_forward(IN, OUT, BATCH, w, b, x, y); \
+    } \
+    static void linear_backward_weights_##IN##_##OUT##_##BATCH(const double* g, const double* x, \
+                                                               double* dw) { \
+        kernel_backward_weights(IN, OUT, BATCH, g, x, dw); \
+    } \
+    static void linear_backward_biases_##IN##_##OUT##_##BATCH(const double* g, double* db) { \
+        kernel_backward_biases(OUT, BATCH, g, db); \
+    } \
+    static void linear_backward_input_##IN##_##OUT##_##BATCH(const double* w, const double* g, \
+                                                             double* dx) { \
+        kernel_backward_input(IN, OUT, BATCH, w, g, dx); \
+    } \
+    static double mse_loss_##IN##_##OUT##_##BATCH(const double* p, const double* t) { \
+        return kernel_mse_loss((OUT) * (BATCH), p, t); \
+    } \
+    static void mse_gradient_##IN##_##OUT##_##BATCH(const double* p, const double* t, double* grad) { \
+        kernel_mse_gradient((OUT) * (BATCH), p, t, grad); \
+    }
+#include NNC_KERNEL_SHAPES
+#undef KERNEL_SHAPE
+
+// Registry, terminated by an all-zero entry so an empty list still compiles
+static const LinearKernels linear_kernels[] = {
+#define KERNEL_SHAPE(IN, OUT, BATCH) \
+    {IN, OUT, BATCH, \
+     linear_forward_##IN##_##OUT##_##BATCH, \
+     linear_backward_weights_##IN##_##OUT##_##BATCH, \
+     linear_backward_biases_##IN##_##OUT##_##BATCH, \
+     linear_backward_input_##IN##_##OUT##_##BATCH, \
+     mse_loss_##IN##_##OUT##_##BATCH, \
+     mse_gradient_##IN##_##OUT##_##BATCH},
+#include NNC_KERNEL_SHAPES
+#undef KERNEL_SHAPE
+    {0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL}
+};
+
+const LinearKernels* kernels_find_linear(size_t in_features, size_t out_features, size_t batch) {
+    if (!atomic_load(&kernels_enabled)) return NULL;
+
+    for (const LinearKernels* k = linear_kernels; k->forward; k++) {
+        if (k->in_features == in_features && k->out_features == out_features && k->batch == batch) {
+            return k;
+        }
+    }
+    return NULL;
+}
+
+const LinearKernels* kernels_find_loss(size_t size) {
+    if (!atomic_load(&kernels_enabled)) return NULL;
+
+    for (const LinearKernels* k = linear_kernels; k->forward; k++) {
+        if (k->out_features * k->batch == size) return k;
+    }
+    return NULL;
+}
+
+void kernels_set_enabled(int enabled) {
+    atomic_store(&kernels_enabled, enabled);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+// Kernels generated at build time for one linear layer shape, see
+// kernels.def. Every pointer is to row-major contiguous data:
+// w [out, in], b [out], x and dx [in, batch], y and g [out, batch].
+typedef struct {
+    size_t in_features;
+    size_t out_features;
+    size_t batch;
+    void (*forward)(const double* w, const double* b, const double* x, double* y);
+    void (*backward_weights)(const double* g, const double* x, double* dw);
+    void (*backward_biases)(const double* g, double* db);
+    void (*backward_input)(const double* w, const double* g, double* dx);
+    // Over out_features * batch elements
+    double (*mse_loss)(const double* predictions, const double* targets);
+    void (*mse_gradient)(const double* predictions, const double* targets, double* grad);
+} LinearKernels;
+
+// NULL when the shape was not declared or kernels are disabled, callers
+// then fall back to the generic kernels
+const LinearKernels* kernels_find_linear(size_t in_features, size_t out_features, size_t batch);
+const LinearKernels* kernels_find_loss(size_t size);
+
+// 0 forces the generic kernels everywhere, for comparisons and benchmarks
+void kernels_set_enabled(int enabled);
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "layer.h"
+
+typedef struct {
+    size_t ndim;
+    size_t shape[8]; // Input shape seen by the last forward
+} FlattenData;
+
+Layer* layer_create(void* layer_data, MDArray* (*forward)(Layer*, MDArray*), MDArray* (*backward)(Layer*, MDArray*)) {
+    Layer* layer = malloc(sizeof(Layer));
+    if (!layer) return NULL;
+
+    layer->layer_data = layer_data;
+    layer->forward = forward;
+    layer->backward = backward;
+    layer->free_data = NULL;
+    layer->zero_grad = NULL;
+    layer->set_accumulate = NULL;
+    layer->release = NULL;
+
+    return layer;
+}
+
+void layer_free(Layer* layer) {
+    if (layer) {
+        if (layer->free_data) layer->free_data(layer->layer_data);
+        free(layer);
+    }
+}
+
+static MDArray* linear_layer_forward(Layer* layer, MDArray* input) {
+    return linear_forward((LinearLayer*)layer->layer_data, input);
+}
+
+static MDArray* linear_layer_backward(Layer* layer, MDArray* grad_output) {
+    return linear_backward((LinearLayer*)layer->layer_data, grad_output);
+}
+
+static void linear_layer_zero_grad(Layer* layer) {
+    linear_zero_grad((LinearLayer*)layer->layer_data);
+}
+
+static int linear_layer_set_accumulate(Layer* layer, int accumulate) {
+    LinearLayer* linear = (LinearLayer*)layer->layer_data;
+    int previous = linear->accumulate;
+    linear->accumulate = accumulate;
+    return previous;
+}
+
+static void linear_layer_release(Layer* layer) {
+    linear_release_input((LinearLayer*)layer->layer_data);
+}
+
+Layer* layer_linear(LinearLayer* linear) {
+    Layer* layer = layer_create(linear, linear_layer_forward, linear_layer_backward);
+    if (layer) {
+        layer->zero_grad = linear_layer_zero_grad;
+        layer->set_accumulate = linear_layer_set_accumulate;
+        layer->release = linear_layer_release;
+    }
+    return layer;
+}
+
+static MDArray* conv2d_layer_forward(Layer* layer, MDArray* input) {
+    return conv2d_forward((Conv2DLayer*)layer->layer_data, input);
+}
+
+static MDArray* conv2d_layer_backward(Layer* layer, MDArray* grad_output) {
+    return conv2d_backward((Conv2DLayer*)layer->layer_data, grad_output);
+}
+
+static void conv2d_layer_zero_grad(Layer* layer) {
+    conv2d_zero_grad((Conv2DLayer*)layer->layer_data);
+}
+
+static int conv2d_layer_set_accumulate(Layer* layer, int accumulate) {
+    Conv2DLayer* conv = (Conv2DLayer*)layer->layer_data;
+    int previous = conv->accumulate;
+    conv->accumulate = accumulate;
+    return previous;
+}
+
+static void conv2d_layer_release(Layer* layer) {
+    conv2d_release_input((Conv2DLayer*)layer->layer_data);
+}
+
+Layer* layer_conv2d(Conv2DLayer* conv) {
+    Layer* layer = layer_create(conv, conv2d_layer_forward, conv2d_layer_backward);
+    if (layer) {
+        layer->zero_grad = conv2d_layer_zero_grad;
+        layer->set_accumulate = conv2d_layer_set_accumulate;
+        layer->release = conv2d_layer_release;
+    }
+    return layer;
+}
+
+static MDArray* pool2d_layer_forward(Layer* layer, MDArray* input) {
+    return pool2d_forward((Pool2DLayer*)layer->layer_data, input);
+}
+
+static MDArray* pool2d_layer_backward(Layer* layer, MDArray* grad_output) {
+    return pool2d_backward((Pool2DLayer*)layer->layer_data, grad_output);
+}
+
+static void pool2d_layer_release(Layer* layer) {
+    pool2d_release_input((Pool2DLayer*)layer->layer_data);
+}
+
+Layer* layer_pool2d(Pool2DLayer* pool) {
+    Layer* layer = layer_create(pool, pool2d_layer_forward, pool2d_layer_backward);
+    if (layer) layer->release = pool2d_layer_release;
+    return layer;
+}
+
+// [n, features...] -> [features, n]
+static MDArray* flatten_forward(Layer* layer, MDArray* input) {
+    FlattenData* data = (FlattenData*)layer->layer_data;
+    if (input->ndim < 2 || input->ndim > 8) return NULL;
+
+    data->ndim = input->ndim;
+    memcpy(data->shape, input->shape, input->ndim * sizeof(size_t));
+
+    size_t n = input->shape[0];
+    size_t features = input->total_size / n;
+    size_t shape[] = {features, n};
+    MDArray* out = mdarray_create(2, shape, sizeof(double));
+    MDArray* packed = mdarray_contiguous(input);
+    if (!out || !packed) {
+        mdarray_free(out);
+        mdarray_free(packed);
+        return NULL;
+    }
+
+    double* src = (double*)packed->data;
+    double* dst = (double*)out->data;
+    for (size_t i = 0; i < n; i++) {
+        for (size_t f = 0; f < features; f++) {
+            dst[f * n + i] = src[i * features + f];
+        }
+    }
+
+    mdarray_free(packed);
+    return out;
+}
+
+// [features, n] -> [n, features...]
+static MDArray* flatten_backward(Layer* layer, MDArray* grad_output) {
+    FlattenData* data = (FlattenData*)layer->layer_data;
+    MDArray* out = mdarray_create(data->ndim, data->shape, sizeof(double));
+    if (!out) return NULL;
+
+    size_t features = grad_output->shape[0];
+    size_t n = grad_output->shape[1];
+    double* src = (double*)grad_output->data;
+    double* dst = (double*)out->data;
+    for (size_t i = 0; i < n; i++) {
+        for (size_t f = 0; f < features; f++) {
+            dst[i * features + f] = src[f * grad_output->strides[0] + i * grad_output->strides[1]];
+        }
+    }
+
+    return out;
+}
+
+Layer* layer_flatten(void) {
+    FlattenData* data = calloc(1, sizeof(FlattenData));
+    if (!data) return NULL;
+
+    Layer* layer = layer_create(data, flatten_forward, flatten_backward);
+    if (!layer) {
+        free(data);
+        return NULL;
+    }
+    layer->free_data = free;
+
+    return layer;
+}
@@ -1,12 +1,35 @@
 #pragma once
 #include "mdarray.h"
+#include "conv.h"
+#include "linear.h"
+#include "pool.h"
 
 typedef struct Layer {
   void* layer_data;
     MDArray* (*forward)(struct Layer*, MDArray*);
     // Backward function should return the gradient with respect to the input
     MDArray* (*backward)(struct Layer*, MDArray*);
+    // Optional, releases layer_data in layer_free
+    void (*free_data)(void*);
+    // Optional, zeros the parameter gradients, allocating them if needed
+    void (*zero_grad)(struct Layer*);
+    // Optional, 1 makes backward add to the parameter gradients instead of
+    // replacing them, for accumulation over micro-batches. Returns the
+    // previous setting.
+    int (*set_accumulate)(struct Layer*, int);
+    // Optional, drops what forward saved for backward, to be rebuilt by
+    // running forward again (activation recomputation)
+    void (*release)(struct Layer*);
 } Layer;
 
 Layer* layer_create(void* layer_data, MDArray* (*forward)(Layer*, MDArray*), MDArray* (*backward)(Layer*, MDArray*));
-void layer_free(Layer* layer);
\ No newline at end of file
+void layer_free(Layer* layer);
+
+// Adapters exposing the concrete layers through the Layer interface.
+// The Layer does not own the wrapped layer.
+Layer* layer_linear(LinearLayer* linear);
+Layer* layer_conv2d(Conv2DLayer* conv);
+Layer* layer_pool2d(Pool2DLayer* pool);
+// Flattens NHWC [n, h, w, c] activations into the [h * w * c, n] layout
+// LinearLayer expects, and back in backward
+Layer* layer_flatten(void);
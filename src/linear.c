@@ -1,89 +1,446 @@
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdalign.h>
 
+#include "autotune.h"
+#include "checkpoint.h"
+#include "gemm.h"
+#include "kernels.h"
 #include "mdarray.h"
 #include "linear.h"
 
-LinearLayer*     linear_new(MDArray* input, MDArray* labels) {
+// Builds a layer around existing parameters, taking over both references
+static LinearLayer* linear_wrap(MDArray* weights, MDArray* biases) {
     // Ensure proper alignment
     LinearLayer* layer = malloc(sizeof(LinearLayer));
     if (!layer) return NULL;
 
-    // Initialize to NULL to avoid issues with cleanup on failure
-    layer->weights = NULL;
-    layer->biases = NULL;
+    layer->weights = weights;
+    layer->biases = biases;
     layer->input = NULL;
     layer->grad_weights = NULL;
     layer->grad_biases = NULL;
+    layer->sparse_input = NULL;
+    layer->owns_sparse_input = 0;
+    layer->grad_task = NULL;
+    layer->accumulate = 0;
 
+    return layer;
+}
+
+LinearLayer* linear_create(size_t in_features, size_t out_features) {
     // Initialize weights with proper shape
-    size_t weights_shape[] = {labels->shape[0], input->shape[0]};
-    layer->weights = mdarray_create(2, weights_shape, sizeof(double));
-    if (!layer->weights) {
-        free(layer);
-        return NULL;
-    }
-    mdarray_ones(layer->weights);
+    size_t weights_shape[] = {out_features, in_features};
+    MDArray* weights = mdarray_create(2, weights_shape, sizeof(double));
 
     // Initialize biases
-    size_t biases_shape[] = {labels->shape[0], 1};
-    layer->biases = mdarray_create(2, biases_shape, sizeof(double));
-    if (!layer->biases) {
-        mdarray_free(layer->weights);
-        free(layer);
+    size_t biases_shape[] = {out_features, 1};
+    MDArray* biases = mdarray_create(2, biases_shape, sizeof(double));
+
+    LinearLayer* layer = weights && biases ? linear_wrap(weights, biases) : NULL;
+    if (!layer) {
+        mdarray_free(weights);
+        mdarray_free(biases);
         return NULL;
     }
+    mdarray_ones(layer->weights);
     mdarray_zeros(layer->biases);
 
-    // Store input pointer (don't copy)
-    layer->input = input;
+    return layer;
+}
+
+int linear_save(LinearLayer* layer, const char* path) {
+    CheckpointTensor tensors[] = {
+        {"linear.weights", layer->weights},
+        {"linear.biases", layer->biases},
+    };
+    return checkpoint_save(path, tensors, 2);
+}
+
+LinearLayer* linear_load(const char* path) {
+    Checkpoint* checkpoint = checkpoint_open(path, 0);
+    if (!checkpoint) return NULL;
+
+    // The views keep the mapping alive after the checkpoint is closed
+    MDArray* weights = checkpoint_get(checkpoint, "linear.weights");
+    MDArray* biases = checkpoint_get(checkpoint, "linear.biases");
+    checkpoint_close(checkpoint);
+
+    LinearLayer* layer = NULL;
+    if (weights && biases && weights->ndim == 2 && biases->ndim == 2 &&
+        biases->shape[0] == weights->shape[0] && biases->shape[1] == 1) {
+        layer = linear_wrap(weights, biases);
+    } else if (weights && biases) {
+        printf("%s does not hold a linear layer\n", path);
+    }
+
+    if (!layer) {
+        mdarray_free(weights);
+        mdarray_free(biases);
+    }
+    return layer;
+}
+
+LinearLayer* linear_new(MDArray* input, MDArray* labels) {
+    LinearLayer* layer = linear_create(input->shape[0], labels->shape[0]);
+    if (!layer) return NULL;
+
+    // Keep a reference to the input, it stays valid if the caller frees theirs
+    layer->input = mdarray_view(input);
 
     return layer;
 }
 
+// Xavier/Glorot uniform initialization, keeps activation variance stable
+// for tanh/sigmoid/linear outputs. Biases are reset to zero.
+void linear_init_xavier(LinearLayer* layer, RNG* rng) {
+    double fan_out = (double)layer->weights->shape[0];
+    double fan_in = (double)layer->weights->shape[1];
+    double limit = sqrt(6.0 / (fan_in + fan_out));
+
+    rng_uniform(rng, layer->weights, -limit, limit);
+    mdarray_zeros(layer->biases);
+}
+
+// He/Kaiming initialization for layers followed by a ReLU.
+// Biases are reset to zero.
+void linear_init_he(LinearLayer* layer, RNG* rng) {
+    double fan_in = (double)layer->weights->shape[1];
+
+    rng_truncated_normal(rng, layer->weights, 0.0, sqrt(2.0 / fan_in) / RNG_TRUNCATED_STDDEV);
+    mdarray_zeros(layer->biases);
+}
+
+static void linear_clear_input(LinearLayer* layer) {
+    mdarray_free(layer->input);
+    layer->input = NULL;
+}
+
+static void linear_clear_sparse_input(LinearLayer* layer) {
+    if (layer->owns_sparse_input) sparse_free(layer->sparse_input);
+    layer->sparse_input = NULL;
+    layer->owns_sparse_input = 0;
+}
+
+static MDArray* linear_add_biases(LinearLayer* layer, MDArray* out) {
+    // Broadcast each bias along its output row (the batch dimension)
+    double* biases = (double*)layer->biases->data;
+    double* data = (double*)out->data;
+    for (size_t i = 0; i < out->shape[0]; i++) {
+        for (size_t j = 0; j < out->shape[1]; j++) {
+            data[i * out->shape[1] + j] += biases[i];
+        }
+    }
+
+    return out;
+}
+
+// Kernels specialized for this layer and batch shape, NULL for the generic path
+static const LinearKernels* linear_find_kernels(LinearLayer* layer, MDArray* input) {
+    if (!input || input->ndim != 2 || input->shape[0] != layer->weights->shape[1]) return NULL;
+    if (!mdarray_is_contiguous(input) || !mdarray_is_contiguous(layer->weights)) return NULL;
+
+    return kernels_find_linear(layer->weights->shape[1], layer->weights->shape[0], input->shape[1]);
+}
+
 MDArray* linear_forward(LinearLayer* layer, MDArray* input) {
-    // Store input for backward pass (just store the pointer, don't copy)
-    layer->input = input;
+    // Store input for backward pass as a view, no copy and no dangling pointer
+    linear_wait_gradients(layer);
+    linear_clear_input(layer);
+    linear_clear_sparse_input(layer);
+    layer->input = mdarray_view(input);
+    if (!layer->input) return NULL;
+
+    // Declared production shapes run the unrolled kernel, bias included
+    const LinearKernels* kernels = linear_find_kernels(layer, input);
+    if (kernels) {
+        size_t shape[] = {layer->weights->shape[0], input->shape[1]};
+        MDArray* out = mdarray_create(2, shape, sizeof(double));
+        if (!out) return NULL;
+        kernels->forward((const double*)layer->weights->data, (const double*)layer->biases->data,
+                         (const double*)input->data, (double*)out->data);
+        return out;
+    }
+
+    // Most MNIST pixels are zero, so skip them when the batch is sparse enough
+    SparseMDArray* sparse = sparse_try_from_dense(input, SPARSE_CSC, SPARSE_DENSITY_THRESHOLD);
+    if (sparse) {
+        layer->sparse_input = sparse;
+        layer->owns_sparse_input = 1;
+    }
 
     // Compute output = weights * input
-    MDArray* out = mdarray_dot(layer->weights, input);
+    MDArray* out = sparse ? sparse_dense_dot(layer->weights, sparse) : mdarray_dot(layer->weights, input);
     if (!out) return NULL;
 
-    // Reshape biases to match the output shape
-    size_t new_shape[] = {layer->biases->shape[0], out->shape[1]};
-    MDArray* reshaped_biases = mdarray_resize(layer->biases, 2, new_shape);
-    if (!reshaped_biases) {
-        mdarray_free(out);
-        return NULL;
+    return linear_add_biases(layer, out);
+}
+
+int linear_infer(LinearLayer* layer, MDArray* input, MDArray* out) {
+    size_t out_features = layer->weights->shape[0];
+    size_t in_features = layer->weights->shape[1];
+    if (input->ndim != 2 || out->ndim != 2 || input->shape[0] != in_features ||
+        out->shape[0] != out_features || out->shape[1] != input->shape[1]) {
+        printf("linear_infer shape mismatch\n");
+        return -1;
+    }
+
+    const LinearKernels* kernels = linear_find_kernels(layer, input);
+    if (kernels && mdarray_is_contiguous(out)) {
+        kernels->forward((const double*)layer->weights->data, (const double*)layer->biases->data,
+                         (const double*)input->data, (double*)out->data);
+        return 0;
+    }
+
+    // Compute output = weights * input straight into out
+    size_t batch = input->shape[1];
+    GemmConfig config = autotune_lookup(out_features, batch, in_features);
+    gemm_dgemm(out_features, batch, in_features,
+               (const double*)layer->weights->data, layer->weights->strides[0], layer->weights->strides[1],
+               (const double*)input->data, input->strides[0], input->strides[1],
+               (double*)out->data, out->strides[0], out->strides[1],
+               0, &config);
+
+    double* biases = (double*)layer->biases->data;
+    double* data = (double*)out->data;
+    for (size_t i = 0; i < out_features; i++) {
+        for (size_t j = 0; j < batch; j++) {
+            data[i * out->strides[0] + j * out->strides[1]] += biases[i];
+        }
     }
 
-    // Add biases
-    MDArray* out_biased = mdarray_sum(out, reshaped_biases);
+    return 0;
+}
+
+MDArray* linear_forward_sparse(LinearLayer* layer, SparseMDArray* input) {
+    // Store input for backward pass (just store the pointer, don't copy)
+    linear_wait_gradients(layer);
+    linear_clear_input(layer);
+    linear_clear_sparse_input(layer);
+    layer->sparse_input = input;
 
-    // Free intermediate results
-    mdarray_free(out);
-    mdarray_free(reshaped_biases);
+    MDArray* out = sparse_dense_dot(layer->weights, input);
+    if (!out) return NULL;
 
-    return out_biased;
+    return linear_add_biases(layer, out);
 }
 
-MDArray* linear_backward(LinearLayer* layer, MDArray* grad_output) {
+// Inputs and results of one weight and bias gradient computation. The
+// dense arrays are views, so the caller may free theirs meanwhile.
+typedef struct {
+    LinearLayer* layer;
+    const LinearKernels* kernels; // Specialized kernels for this shape, if any
+    MDArray* input;
+    SparseMDArray* sparse_input;
+    MDArray* grad_output;
+    MDArray* grad_weights;
+    MDArray* grad_biases;
+    int accumulate;               // Add into the layer's gradients instead of replacing them
+} LinearGradients;
+
+// dL/dW += grad_output * input^T straight into the layer's gradient
+static void linear_accumulate_weights(LinearGradients* g) {
+    MDArray* dw = g->layer->grad_weights;
+    double* dst = (double*)dw->data;
+
+    if (g->sparse_input) {
+        MDArray* partial = dense_sparse_t_dot(g->grad_output, g->sparse_input);
+        if (partial) {
+            for (size_t i = 0; i < dw->total_size; i++) dst[i] += ((double*)partial->data)[i];
+        }
+        mdarray_free(partial);
+        return;
+    }
+
+    MDArray* x = g->input;
+    MDArray* go = g->grad_output;
+    size_t m = dw->shape[0], n = dw->shape[1], k = go->shape[1];
+    GemmConfig config = autotune_lookup(m, n, k);
+    gemm_dgemm(m, n, k,
+               (const double*)go->data, go->strides[0], go->strides[1],
+               (const double*)x->data, x->strides[1], x->strides[0],
+               dst, dw->strides[0], dw->strides[1],
+               1, &config);
+}
+
+// dL/db += grad_output summed along the batch dimension
+static void linear_accumulate_biases(LinearGradients* g) {
+    MDArray* go = g->grad_output;
+    const double* src = (const double*)go->data;
+    double* db = (double*)g->layer->grad_biases->data;
+
+    for (size_t o = 0; o < go->shape[0]; o++) {
+        double sum = 0.0;
+        for (size_t j = 0; j < go->shape[1]; j++) sum += src[o * go->strides[0] + j * go->strides[1]];
+        db[o] += sum;
+    }
+}
+
+static void linear_grad_weights_task(void* ctx) {
+    LinearGradients* g = (LinearGradients*)ctx;
+
     // Compute dL/dW = grad_output * input^T
-    MDArray* input_transposed = mdarray_transpose(layer->input);
-    MDArray* dL_dW = mdarray_dot(grad_output, input_transposed);
-    mdarray_free(input_transposed);
+    if (g->accumulate) {
+        linear_accumulate_weights(g);
+    } else if (g->kernels) {
+        g->grad_weights = mdarray_create(2, g->layer->weights->shape, sizeof(double));
+        if (g->grad_weights) {
+            g->kernels->backward_weights((const double*)g->grad_output->data, (const double*)g->input->data,
+                                         (double*)g->grad_weights->data);
+        }
+    } else if (g->sparse_input) {
+        g->grad_weights = dense_sparse_t_dot(g->grad_output, g->sparse_input);
+    } else if (g->input) {
+        MDArray* input_transposed = mdarray_transpose_view(g->input);
+        g->grad_weights = mdarray_dot(g->grad_output, input_transposed);
+        mdarray_free(input_transposed);
+    }
+}
+
+static void linear_grad_biases_task(void* ctx) {
+    LinearGradients* g = (LinearGradients*)ctx;
 
     // Compute dL/db = sum of grad_output along the batch dimension
-    MDArray* dL_db = mdarray_sum_along_axis(grad_output, 1);
+    if (g->accumulate) {
+        linear_accumulate_biases(g);
+    } else if (g->kernels) {
+        g->grad_biases = mdarray_create(1, g->grad_output->shape, sizeof(double));
+        if (g->grad_biases) {
+            g->kernels->backward_biases((const double*)g->grad_output->data, (double*)g->grad_biases->data);
+        }
+    } else {
+        g->grad_biases = mdarray_sum_along_axis(g->grad_output, 1);
+    }
+}
 
-    // Compute dL/dX = W^T * grad_output
-    MDArray* weights_transposed = mdarray_transpose(layer->weights);
-    MDArray* dL_dX = mdarray_dot(weights_transposed, grad_output);
-    mdarray_free(weights_transposed);
+// Runs after both gradients are ready
+static void linear_store_gradients_task(void* ctx) {
+    LinearGradients* g = (LinearGradients*)ctx;
 
     // Store gradients in the layer for later use
-    layer->grad_weights = dL_dW;
-    layer->grad_biases = dL_db;
+    if (!g->accumulate) {
+        mdarray_free(g->layer->grad_weights);
+        mdarray_free(g->layer->grad_biases);
+        g->layer->grad_weights = g->grad_weights;
+        g->layer->grad_biases = g->grad_biases;
+    }
+
+    mdarray_free(g->input);
+    mdarray_free(g->grad_output);
+    free(g);
+}
+
+// Queues dW, db and a task storing both once they are done, so the two
+// run alongside each other and alongside dX. Returns NULL when the tasks
+// could not be created, the caller then runs the steps inline.
+static Task* linear_submit_gradients(LinearGradients* g) {
+    Task* weights = task_create(linear_grad_weights_task, g);
+    Task* biases = task_create(linear_grad_biases_task, g);
+    Task* store = task_create(linear_store_gradients_task, g);
+    if (!weights || !biases || !store ||
+        task_depends_on(store, weights) != 0 || task_depends_on(store, biases) != 0) {
+        task_release(weights);
+        task_release(biases);
+        task_release(store);
+        return NULL;
+    }
+
+    task_submit(store);
+    task_submit(weights);
+    task_submit(biases);
+    task_release(weights);
+    task_release(biases);
+
+    return store;
+}
+
+MDArray* linear_backward_async(LinearLayer* layer, MDArray* grad_output) {
+    linear_wait_gradients(layer);
+
+    LinearGradients* g = (LinearGradients*)calloc(1, sizeof(LinearGradients));
+    if (!g) return NULL;
+    g->layer = layer;
+    g->sparse_input = layer->sparse_input;
+    g->input = layer->input ? mdarray_view(layer->input) : NULL;
+    g->grad_output = mdarray_view(grad_output);
+    // Accumulating needs gradients of the usual layout from an earlier backward
+    g->accumulate = layer->accumulate && layer->grad_weights && layer->grad_biases &&
+                    (g->input || g->sparse_input) &&
+                    mdarray_is_contiguous(layer->grad_weights) && mdarray_is_contiguous(layer->grad_biases) &&
+                    mdarray_make_writable(layer->grad_weights) == 0 &&
+                    mdarray_make_writable(layer->grad_biases) == 0;
+    if (!g->sparse_input && mdarray_is_contiguous(grad_output) &&
+        grad_output->ndim == 2 && grad_output->shape[0] == layer->weights->shape[0]) {
+        g->kernels = linear_find_kernels(layer, g->input);
+    }
+    // The storing task frees g, read what dX needs before submitting
+    const LinearKernels* kernels = g->kernels;
+
+    layer->grad_task = linear_submit_gradients(g);
+
+    // Compute dL/dX = W^T * grad_output while the gradients are in flight
+    MDArray* dL_dX;
+    if (kernels) {
+        size_t shape[] = {layer->weights->shape[1], grad_output->shape[1]};
+        dL_dX = mdarray_create(2, shape, sizeof(double));
+        if (dL_dX) {
+            kernels->backward_input((const double*)layer->weights->data, (const double*)grad_output->data,
+                                       (double*)dL_dX->data);
+        }
+    } else {
+        MDArray* weights_transposed = mdarray_transpose_view(layer->weights);
+        dL_dX = mdarray_dot(weights_transposed, grad_output);
+        mdarray_free(weights_transposed);
+    }
+
+    if (!layer->grad_task) {
+        linear_grad_weights_task(g);
+        linear_grad_biases_task(g);
+        linear_store_gradients_task(g);
+    }
+
+    return dL_dX;
+}
+
+void linear_wait_gradients(LinearLayer* layer) {
+    if (layer->grad_task) {
+        task_wait(layer->grad_task);
+        task_release(layer->grad_task);
+        layer->grad_task = NULL;
+    }
+}
+
+void linear_zero_grad(LinearLayer* layer) {
+    linear_wait_gradients(layer);
+    if (!layer->grad_weights) layer->grad_weights = mdarray_create(2, layer->weights->shape, sizeof(double));
+    if (!layer->grad_biases) layer->grad_biases = mdarray_create(1, layer->weights->shape, sizeof(double));
+    if (layer->grad_weights) mdarray_zeros(layer->grad_weights);
+    if (layer->grad_biases) mdarray_zeros(layer->grad_biases);
+}
+
+void linear_release_input(LinearLayer* layer) {
+    linear_wait_gradients(layer);
+    linear_clear_input(layer);
+    linear_clear_sparse_input(layer);
+}
+
+MDArray* linear_backward(LinearLayer* layer, MDArray* grad_output) {
+    MDArray* dL_dX = linear_backward_async(layer, grad_output);
+    linear_wait_gradients(layer);
 
     return dL_dX;
 }
+
+void linear_free(LinearLayer* layer) {
+    if (layer) {
+        linear_wait_gradients(layer);
+        linear_clear_input(layer);
+        linear_clear_sparse_input(layer);
+        mdarray_free(layer->weights);
+        mdarray_free(layer->biases);
+        mdarray_free(layer->grad_weights);
+        mdarray_free(layer->grad_biases);
+        free(layer);
+    }
+}
@@ -1,19 +1,51 @@
 #pragma once
 
 #include "mdarray.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "sparse.h"
 
 typedef struct {
     MDArray* weights;
     MDArray* biases;
-    MDArray* input;
+    MDArray* input;              // View of the last forward input, holds a buffer reference
     MDArray* grad_weights;
     MDArray* grad_biases;
+    SparseMDArray* sparse_input; // Compressed copy of input when it was sparse enough
+    int owns_sparse_input;       // 1 if the layer built sparse_input and must free it
+    Task* grad_task;             // Pending gradients from linear_backward_async
+    int accumulate;              // 1 to add backward's gradients to grad_weights and grad_biases
     char padding[8];
 } LinearLayer;
 
 MDArray* linear_forward(LinearLayer* layer, MDArray* input);
+MDArray* linear_forward_sparse(LinearLayer* layer, SparseMDArray* input);
+// Stateless forward into a caller-provided out [out_features, batch].
+// Nothing is kept for backward, so threads may share the layer.
+// Returns 0 on success.
+int linear_infer(LinearLayer* layer, MDArray* input, MDArray* out);
 MDArray* linear_backward(LinearLayer* layer, MDArray* grad_output);
+// Returns dL/dX and leaves dL/dW and dL/db computing on the scheduler, so
+// they overlap with the backward pass of the layers below. Call
+// linear_wait_gradients before reading grad_weights or grad_biases. A
+// sparse input from linear_forward_sparse must stay alive until then.
+MDArray* linear_backward_async(LinearLayer* layer, MDArray* grad_output);
+void linear_wait_gradients(LinearLayer* layer);
+// Zeros grad_weights and grad_biases in place, for accumulation over
+// micro-batches with accumulate set. Allocates them if no backward ran yet.
+void linear_zero_grad(LinearLayer* layer);
+// Drops the input saved by the last forward, backward needs a new forward
+void linear_release_input(LinearLayer* layer);
 LinearLayer* linear_new(MDArray* images, MDArray* labels);
+LinearLayer* linear_create(size_t in_features, size_t out_features);
+void linear_free(LinearLayer* layer);
+// Weights and biases as a checkpoint (checkpoint.h). A loaded layer's
+// parameters are read-only views on the shared mapping: inference reads
+// them in place, writers go through mdarray_make_writable first.
+int linear_save(LinearLayer* layer, const char* path);
+LinearLayer* linear_load(const char* path);
+void linear_init_xavier(LinearLayer* layer, RNG* rng);
+void linear_init_he(LinearLayer* layer, RNG* rng);
 
 // Structure to hold array metadata
 typedef struct {
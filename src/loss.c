@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "kernels.h"
 #include "loss.h"
 
 double mse_loss(MDArray* predictions, MDArray* targets) {
@@ -10,13 +11,30 @@ double mse_loss(MDArray* predictions, MDArray* targets) {
         return -1.0;
     }
 
+    // Declared model shapes have an unrolled kernel
+    const LinearKernels* kernels = kernels_find_loss(predictions->total_size);
+    if (kernels && mdarray_is_contiguous(predictions) && mdarray_is_contiguous(targets)) {
+        return kernels->mse_loss((const double*)predictions->data, (const double*)targets->data);
+    }
+
+    // Element i of both must be at offset i, so pack strided views first
+    MDArray* pred_packed = mdarray_contiguous(predictions);
+    MDArray* target_packed = mdarray_contiguous(targets);
+    if (!pred_packed || !target_packed) {
+        mdarray_free(pred_packed);
+        mdarray_free(target_packed);
+        return -1.0;
+    }
+
     double loss = 0.0;
     for (size_t i = 0; i < predictions->total_size; i++) {
-        double pred = *(double*)((char*)predictions->data + i * predictions->itemsize);
-        double target = *(double*)((char*)targets->data + i * targets->itemsize);
+        double pred = *(double*)((char*)pred_packed->data + i * predictions->itemsize);
+        double target = *(double*)((char*)target_packed->data + i * targets->itemsize);
         loss += pow(pred - target, 2);
     }
 
+    mdarray_free(pred_packed);
+    mdarray_free(target_packed);
     return loss / predictions->total_size;
 }
 
@@ -27,14 +45,30 @@ MDArray* mse_loss_gradient(MDArray* predictions, MDArray* targets) {
     }
 
     MDArray* grad = mdarray_create(predictions->ndim, predictions->shape, sizeof(double));
-    if (!grad) return NULL;
+    const LinearKernels* kernels = kernels_find_loss(predictions->total_size);
+    if (grad && kernels && mdarray_is_contiguous(predictions) && mdarray_is_contiguous(targets)) {
+        kernels->mse_gradient((const double*)predictions->data, (const double*)targets->data,
+                              (double*)grad->data);
+        return grad;
+    }
+
+    MDArray* pred_packed = mdarray_contiguous(predictions);
+    MDArray* target_packed = mdarray_contiguous(targets);
+    if (!grad || !pred_packed || !target_packed) {
+        mdarray_free(grad);
+        mdarray_free(pred_packed);
+        mdarray_free(target_packed);
+        return NULL;
+    }
 
     for (size_t i = 0; i < predictions->total_size; i++) {
-        double pred = *(double*)((char*)predictions->data + i * predictions->itemsize);
-        double target = *(double*)((char*)targets->data + i * targets->itemsize);
+        double pred = *(double*)((char*)pred_packed->data + i * predictions->itemsize);
+        double target = *(double*)((char*)target_packed->data + i * targets->itemsize);
         double gradient = 2 * (pred - target) / predictions->total_size;
         memcpy((char*)grad->data + i * grad->itemsize, &gradient, grad->itemsize);
     }
 
+    mdarray_free(pred_packed);
+    mdarray_free(target_packed);
     return grad;
-}
\ No newline at end of file
+}
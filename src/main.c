@@ -1,59 +1,22 @@
+#include <signal.h>
 #include <stdio.h>
-#include <jpeglib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <math.h>
 #include "mdarray.h"
+#include "autotune.h"
+#include "eval.h"
+#include "export.h"
 #include "linear.h"
+#include "rng.h"
+#include "server.h"
+#include "sparse.h"
 
 #define IMG_SIZE 784
-
-void write_jpeg(MDArray* imgs) {
-    unsigned char grayscale_data[IMG_SIZE];
-    for (size_t x = 0; x < 28; x++) {
-        for (size_t y = 0; y < 28; y++) {
-            size_t idx[] = {0, x, y};
-            grayscale_data[x * 28 + y] = (unsigned char)*(double*)mdarray_get_element(imgs, idx);
-        }
-    }
-
-    // Set up libjpeg structures
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
-
-    // Open the output file
-    FILE *outfile = fopen("example.jpeg", "wb");
-    if (!outfile) {
-        perror("Error opening file");
-        return;
-    }
-    jpeg_stdio_dest(&cinfo, outfile);
-
-    // Set image parameters
-    cinfo.image_width = 28;       // Image width
-    cinfo.image_height = 28;      // Image height
-    cinfo.input_components = 1;   // Grayscale (1 channel)
-    cinfo.in_color_space = JCS_GRAYSCALE;
-
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, 100, TRUE); // Quality: 0-100
-    jpeg_start_compress(&cinfo, TRUE);
-
-    // Write the grayscale image row by row
-    while (cinfo.next_scanline < cinfo.image_height) {
-        JSAMPROW row_pointer[1];
-        row_pointer[0] = &grayscale_data[cinfo.next_scanline * 28];
-        //size_t idx[] = {0, cinfo.next_scanline, 0};
-        //row_pointer[0] = (unsigned char*)mdarray_get_element(imgs, idx);
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
-    }
-
-    // Finish compression and cleanup
-    jpeg_finish_compress(&cinfo);
-    jpeg_destroy_compress(&cinfo);
-    fclose(outfile);
-}
+#define NUM_CLASSES 10
+#define SEED 42
+#define MAX_EXPORTED 64
 
 int read_int(FILE* file) {
     unsigned char msb[4];
@@ -104,7 +67,76 @@ MDArray* read_images(char* filename) {
         index++;
     }
 
-    write_jpeg(imgs);
+    fclose(file);
+
+    return imgs;
+}
+
+// read_images_sparse loads the images as a [784, N] CSC matrix, one column
+// per sample, keeping only the non-zero pixels.
+SparseMDArray* read_images_sparse(char* filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        perror("Error opening file");
+        return NULL;
+    }
+
+    int msb = read_int(file);
+    int n_samples = read_int(file);
+    int r_size = read_int(file);
+    int c_size = read_int(file);
+    if (msb == -1 || n_samples < 0 || r_size == -1 || c_size == -1) {
+        printf("%s has a truncated header\n", filename);
+        fclose(file);
+        return NULL;
+    }
+
+    printf("Magic number: %d\n", msb);
+    printf("Number images: %d\n", n_samples);
+    printf("Image shape %dx%d\n", r_size, c_size);
+
+    // Roughly 20% of MNIST pixels are non-zero, grow if a dataset is denser
+    size_t capacity = (size_t)n_samples * IMG_SIZE / 4 + 1;
+    SparseMDArray* imgs = sparse_create(SPARSE_CSC, IMG_SIZE, n_samples, capacity);
+    if (!imgs) {
+        fclose(file);
+        return NULL;
+    }
+
+    unsigned char imgbytes[IMG_SIZE];
+    size_t nnz = 0;
+    int index = 0;
+    for (; index < n_samples && fread(imgbytes, 1, IMG_SIZE, file) == IMG_SIZE; index++) {
+        if (nnz + IMG_SIZE > capacity) {
+            capacity *= 2;
+            size_t* indices = realloc(imgs->indices, capacity * sizeof(size_t));
+            if (indices) imgs->indices = indices;
+            double* values = realloc(imgs->values, capacity * sizeof(double));
+            if (values) imgs->values = values;
+            if (!indices || !values) {
+                sparse_free(imgs);
+                fclose(file);
+                return NULL;
+            }
+        }
+
+        for (size_t i = 0; i < IMG_SIZE; i++) {
+            if (imgbytes[i] == 0) continue;
+            imgs->indices[nnz] = i;
+            imgs->values[nnz] = (double)imgbytes[i];
+            nnz++;
+        }
+        imgs->indptr[index + 1] = nnz;
+    }
+    imgs->nnz = nnz;
+
+    // A short file keeps the images that were read in full
+    if (index < n_samples) {
+        printf("%s holds %d of %d images\n", filename, index, n_samples);
+        imgs->shape[1] = (size_t)index;
+    }
+
+    printf("Image density: %f\n", sparse_density(imgs));
     fclose(file);
 
     return imgs;
@@ -145,13 +177,131 @@ MDArray* read_labels(char* filename) {
     return labels;
 }
 
-int main() {
-    MDArray* images = read_images("../data/train-images.idx3-ubyte");
+// Densifies the given columns of the [784, N] images into [n, 28, 28]
+static MDArray* gather_images(SparseMDArray* images, const size_t* indices, size_t n) {
+    size_t shape[] = {n, 28, 28};
+    MDArray* out = mdarray_create(3, shape, sizeof(double));
+    if (!out) return NULL;
+
+    mdarray_zeros(out);
+    double* data = (double*)out->data;
+    for (size_t i = 0; i < n; i++) {
+        size_t j = indices[i];
+        for (size_t p = images->indptr[j]; p < images->indptr[j + 1]; p++) {
+            data[i * IMG_SIZE + images->indices[p]] = images->values[p];
+        }
+    }
+    return out;
+}
+
+static void handle_stop(int sig) {
+    (void)sig;
+    server_stop();
+}
+
+// NNC serve <socket> [max_batch] [max_delay_us] [checkpoint]
+static int serve(int argc, char** argv) {
+    ServerConfig config = server_default_config(argv[2]);
+    if (argc > 3) config.max_batch = (size_t)atol(argv[3]);
+    if (argc > 4) config.max_delay_us = atol(argv[4]);
+
+    // A checkpoint is mapped rather than read, so server processes started
+    // from the same file share its pages
+    LinearLayer* layer = NULL;
+    if (argc > 5) {
+        layer = linear_load(argv[5]);
+    } else {
+        RNG rng = rng_new(SEED);
+        layer = linear_create(IMG_SIZE, NUM_CLASSES);
+        if (layer) linear_init_xavier(layer, &rng);
+    }
+    if (!layer) return 1;
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+    int status = server_run(layer, &config);
+    ServerStats stats = server_stats();
+    printf("Served %zu requests in %zu batches (largest %zu)\n", stats.requests, stats.batches, stats.largest_batch);
+
+    linear_free(layer);
+    return status == 0 ? 0 : 1;
+}
+
+// NNC loadgen <socket> [clients] [requests_per_client]
+static int loadgen(int argc, char** argv) {
+    LoadgenConfig config = {8, 1000, IMG_SIZE, NUM_CLASSES};
+    if (argc > 3) config.clients = (size_t)atol(argv[3]);
+    if (argc > 4) config.requests_per_client = (size_t)atol(argv[4]);
+
+    LoadgenResult result;
+    int status = server_loadgen(argv[2], &config, &result);
+    printf("Requests: %zu (%zu errors) in %.3f s\n", result.requests, result.errors, result.seconds);
+    printf("Throughput: %.1f req/s\n", result.throughput);
+    printf("Latency p50: %.1f us, p99: %.1f us\n", result.p50_us, result.p99_us);
+    return status == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && strcmp(argv[1], "serve") == 0) return serve(argc, argv);
+    if (argc > 2 && strcmp(argv[1], "loadgen") == 0) return loadgen(argc, argv);
+
+    SparseMDArray* images = read_images_sparse("../data/train-images.idx3-ubyte");
     MDArray* labels = read_labels("../data/train-labels.idx1-ubyte");
+    if (!images || !labels) return 1;
 
+    // NNC_AUTOTUNE=1 benchmarks this model's GEMM shapes and caches the winners
+    if (getenv("NNC_AUTOTUNE")) {
+        size_t n = images->shape[1];
+        autotune_gemm(NUM_CLASSES, n, IMG_SIZE);   // forward: W * X
+        autotune_gemm(NUM_CLASSES, IMG_SIZE, n);   // weight gradient: G * X^T
+        autotune_gemm(IMG_SIZE, n, NUM_CLASSES);   // input gradient: W^T * G
+        autotune_save(autotune_cache_path());
+    }
+
+    // NNC_CHECKPOINT=path reuses the parameters stored there, or saves the
+    // freshly initialized ones for the next run. A checkpoint that exists but
+    // does not fit this model is an error, and is left as it is.
+    const char* checkpoint = getenv("NNC_CHECKPOINT");
+    LinearLayer* layer = NULL;
+    if (checkpoint && access(checkpoint, F_OK) == 0) {
+        layer = linear_load(checkpoint);
+        if (!layer || layer->weights->shape[0] != NUM_CLASSES || layer->weights->shape[1] != images->shape[0]) {
+            printf("Checkpoint %s does not hold a %d x %zu layer\n", checkpoint, NUM_CLASSES, images->shape[0]);
+            linear_free(layer);
+            mdarray_free(labels);
+            sparse_free(images);
+            return 1;
+        }
+    } else {
+        RNG rng = rng_new(SEED);
+        layer = linear_create(images->shape[0], NUM_CLASSES);
+        if (!layer) return 1;
+        linear_init_xavier(layer, &rng);
+        if (checkpoint && linear_save(layer, checkpoint) == 0) printf("Saved %s\n", checkpoint);
+    }
+
+    // Stream the dataset through the model in chunks instead of one
+    // [10, N] output over a densified [784, N] input
+    Exporter* exporter = exporter_create(NULL);
+    size_t misclassified[MAX_EXPORTED];
+    EvalConfig config = eval_default_config();
+    config.misclassified = misclassified;
+    config.max_misclassified = MAX_EXPORTED;
+
+    EvalResult result;
+    if (eval_linear(layer, images->shape[0], images->shape[1], eval_fill_sparse, images, labels, &config, &result) == 0) {
+        eval_print(&result);
+
+        // Written in the background while the program carries on
+        MDArray* wrong = result.n_misclassified ? gather_images(images, misclassified, result.n_misclassified) : NULL;
+        if (exporter && wrong && exporter_grid(exporter, wrong, NULL, wrong->shape[0], 8, "misclassified.jpeg") == 0) {
+            printf("Exporting %zu misclassified samples to misclassified.jpeg\n", wrong->shape[0]);
+        }
+        mdarray_free(wrong);
+    }
 
-    LinearModel* model = linearmodel_new(images, labels);
-    MDArray* out = linearmodel_forward(model);
-    size_t shape[] = {0,0};
-    printf("Value is %f\n", *(double*) mdarray_get_element(out, shape));
+    exporter_free(exporter);
+    linear_free(layer);
+    mdarray_free(labels);
+    sparse_free(images);
 }
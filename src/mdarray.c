@@ -1,67 +1,208 @@
 #pragma once
 
 #include "mdarray.h"
+#include "allocator.h"
+#include "autotune.h"
+#include "gemm.h"
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
-MDArray* mdarray_create(size_t ndim, size_t* shape, size_t itemsize) {
-    MDArray* arr = (MDArray*)malloc(sizeof(MDArray));
-    if (!arr) return NULL;
+static void mdbuffer_allocator_dealloc(void* ctx, void* data, size_t bytes) {
+    (void)ctx;
+    allocator_free(data, bytes);
+}
+
+// mdarray_create puts the array and its buffer's metadata in one block.
+// Views may keep the buffer alive after the array is freed and the array
+// may move to another buffer (mdarray_make_writable), so the block goes
+// away once both of them are done with it.
+typedef struct {
+    MDArray array;
+    MDBuffer buffer;
+    atomic_int owners;
+} MDArrayBlock;
+
+static void mdarray_block_release(MDArrayBlock* block) {
+    if (atomic_fetch_sub_explicit(&block->owners, 1, memory_order_acq_rel) == 1) free(block);
+}
+
+static void mdbuffer_init(MDBuffer* buffer, void* data, size_t bytes, mdbuffer_dealloc_fn dealloc, void* ctx) {
+    buffer->data = data;
+    buffer->bytes = bytes;
+    atomic_init(&buffer->refcount, 1);
+    buffer->readonly = 0;
+    buffer->dealloc = dealloc;
+    buffer->dealloc_ctx = ctx;
+    buffer->embedded = 0;
+}
+
+MDBuffer* mdbuffer_wrap(void* data, size_t bytes, mdbuffer_dealloc_fn dealloc, void* ctx) {
+    MDBuffer* buffer = (MDBuffer*)malloc(sizeof(MDBuffer));
+    if (!buffer) return NULL;
+
+    mdbuffer_init(buffer, data, bytes, dealloc, ctx);
+    return buffer;
+}
+
+MDBuffer* mdbuffer_create(size_t bytes) {
+    // Aligned for SIMD and huge-page backed when large
+    void* data = allocator_alloc(bytes);
+    if (!data) return NULL;
+
+    MDBuffer* buffer = mdbuffer_wrap(data, bytes, mdbuffer_allocator_dealloc, NULL);
+    if (!buffer) allocator_free(data, bytes);
+    return buffer;
+}
+
+MDBuffer* mdbuffer_retain(MDBuffer* buffer) {
+    atomic_fetch_add_explicit(&buffer->refcount, 1, memory_order_relaxed);
+    return buffer;
+}
+
+void mdbuffer_release(MDBuffer* buffer) {
+    if (!buffer) return;
+
+    // acq_rel so every write made through other references happens before the free
+    if (atomic_fetch_sub_explicit(&buffer->refcount, 1, memory_order_acq_rel) != 1) return;
+
+    if (buffer->dealloc) buffer->dealloc(buffer->dealloc_ctx, buffer->data, buffer->bytes);
+    if (buffer->embedded) {
+        mdarray_block_release((MDArrayBlock*)((char*)buffer - offsetof(MDArrayBlock, buffer)));
+    } else {
+        free(buffer);
+    }
+}
 
+// Fills in the metadata of an array without any storage.
+// strides NULL means row-major.
+static int mdarray_init_header(MDArray* arr, size_t ndim, size_t* shape, size_t* strides, size_t itemsize) {
     arr->ndim = ndim;
     arr->itemsize = itemsize;
-
-    // Allocate and copy shape array
-    arr->shape = (size_t*)malloc(ndim * sizeof(size_t));
-    if (!arr->shape) {
-        free(arr);
-        return NULL;
+    arr->data = NULL;
+    arr->buffer = NULL;
+    arr->copy_on_write = 0;
+    arr->embedded = 0;
+
+    // Shape and strides share one allocation beyond the inline rank
+    if (ndim <= MDARRAY_MAX_INLINE_DIMS) {
+        arr->shape = arr->inline_shape;
+        arr->strides = arr->inline_strides;
+    } else {
+        arr->shape = (size_t*)malloc(2 * ndim * sizeof(size_t));
+        if (!arr->shape) return -1;
+        arr->strides = arr->shape + ndim;
     }
     memcpy(arr->shape, shape, ndim * sizeof(size_t));
 
+    arr->total_size = 1;
+    for (size_t i = 0; i < ndim; i++) {
+        arr->total_size *= shape[i];
+    }
+
     // Calculate strides
-    arr->strides = (size_t*)malloc(ndim * sizeof(size_t));
-    if (!arr->strides) {
-        free(arr->shape);
+    if (strides) {
+        memcpy(arr->strides, strides, ndim * sizeof(size_t));
+    } else {
+        size_t stride = 1;
+        for (size_t i = ndim - 1; i < ndim; i--) {
+            arr->strides[i] = stride;
+            stride *= shape[i];
+        }
+    }
+
+    return 0;
+}
+
+static MDArray* mdarray_header(size_t ndim, size_t* shape, size_t* strides, size_t itemsize) {
+    MDArray* arr = (MDArray*)malloc(sizeof(MDArray));
+    if (!arr) return NULL;
+
+    if (mdarray_init_header(arr, ndim, shape, strides, itemsize) != 0) {
         free(arr);
         return NULL;
     }
+    return arr;
+}
 
-    arr->total_size = 1;
-    for (size_t i = 0; i < ndim; i++) {
-        arr->total_size *= shape[i];
+static void mdarray_free_header(MDArray* arr) {
+    if (arr->shape != arr->inline_shape) free(arr->shape);
+    if (arr->embedded) {
+        mdarray_block_release((MDArrayBlock*)arr);
+    } else {
+        free(arr);
     }
+}
 
-    size_t stride = 1;
-    for (size_t i = ndim - 1; i < ndim; i--) {
-        arr->strides[i] = stride;
-        stride *= shape[i];
+MDArray* mdarray_create(size_t ndim, size_t* shape, size_t itemsize) {
+    // One malloc for the array and its buffer, the elements come from the allocator
+    MDArrayBlock* block = (MDArrayBlock*)malloc(sizeof(MDArrayBlock));
+    if (!block) return NULL;
+
+    MDArray* arr = &block->array;
+    if (mdarray_init_header(arr, ndim, shape, NULL, itemsize) != 0) {
+        free(block);
+        return NULL;
     }
 
-    // Allocate data array
-    arr->data = malloc(arr->total_size * itemsize);
-    if (!arr->data) {
-        free(arr->strides);
-        free(arr->shape);
-        free(arr);
+    size_t bytes = arr->total_size * itemsize;
+    void* data = allocator_alloc(bytes);
+    if (!data) {
+        if (arr->shape != arr->inline_shape) free(arr->shape);
+        free(block);
         return NULL;
     }
 
-    arr->owns_data = 1; // This MDArray owns its data
+    mdbuffer_init(&block->buffer, data, bytes, mdbuffer_allocator_dealloc, NULL);
+    block->buffer.embedded = 1;
+    atomic_init(&block->owners, 2);
+    arr->embedded = 1;
+    arr->buffer = &block->buffer;
+    arr->data = data;
 
     return arr;
 }
 
+MDArray* mdarray_from_buffer(MDBuffer* buffer, size_t offset, size_t ndim, size_t* shape,
+                             size_t* strides, size_t itemsize) {
+    MDArray* arr = mdarray_header(ndim, shape, strides, itemsize);
+    if (!arr) return NULL;
+
+    // The last element reachable through the strides must lie inside the buffer
+    size_t last = 0;
+    for (size_t i = 0; i < ndim; i++) {
+        if (shape[i] > 0) last += (shape[i] - 1) * arr->strides[i];
+    }
+    if (arr->total_size > 0 && offset + (last + 1) * itemsize > buffer->bytes) {
+        printf("View of %zu elements at offset %zu exceeds buffer of %zu bytes\n",
+               arr->total_size, offset, buffer->bytes);
+        mdarray_free_header(arr);
+        return NULL;
+    }
+
+    arr->buffer = mdbuffer_retain(buffer);
+    arr->data = (char*)buffer->data + offset;
+
+    return arr;
+}
+
+// New reference to arr's buffer, element_offset elements past arr->data
+static MDArray* mdarray_share(MDArray* arr, size_t element_offset, size_t ndim, size_t* shape, size_t* strides) {
+    MDArray* view = mdarray_header(ndim, shape, strides, arr->itemsize);
+    if (!view) return NULL;
+
+    view->buffer = mdbuffer_retain(arr->buffer);
+    view->data = (char*)arr->data + element_offset * arr->itemsize;
+    view->copy_on_write = arr->copy_on_write;
+
+    return view;
+}
 
 void mdarray_free(MDArray* arr) {
     if (arr) {
-        if (arr->owns_data)
-           free(arr->data);
-        free(arr->shape);
-        free(arr->strides);
-        free(arr);
+        mdbuffer_release(arr->buffer);
+        mdarray_free_header(arr);
     }
 }
 
@@ -87,6 +228,7 @@ void* mdarray_get_element(MDArray* arr, size_t* indices) {
 
 void mdarray_set_element(MDArray* arr, size_t* indices, void* value) {
     size_t index = mdarray_calculate_index(arr, indices);
+    if (index == (size_t)-1 || mdarray_make_writable(arr) != 0) return;
     memcpy((char*)arr->data + (index * arr->itemsize), value, arr->itemsize);
 }
 
@@ -108,111 +250,50 @@ MDArray* mdarray_dot(MDArray* x, MDArray* y) {
 
     size_t shape[] = {x->shape[0], y->shape[1]};
     MDArray* out = mdarray_create(2, shape, sizeof(double));
-    for(size_t i = 0; i < x->shape[0]; i++) {
-        for(size_t k = 0; k < y->shape[1]; k++) {
-            double outval = 0;  // Reset for each element of output matrix
-            for(size_t j = 0; j < y->shape[0]; j++) {
-                size_t ix[] = {i, j};
-                size_t iy[] = {j, k};
-                double xval = *(double*) mdarray_get_element(x, ix);
-                double yval = *(double*) mdarray_get_element(y, iy);
-                outval += xval*yval;
-            }
-            size_t idx[] = {i, k};
-            mdarray_set_element(out, idx, &outval);  // Write after full sum is computed
-        }
-    }
+    if (!out) return NULL;
+
+    // Blocked kernel with the block sizes tuned for this shape class, if any
+    size_t m = x->shape[0], n = y->shape[1], k = x->shape[1];
+    GemmConfig config = autotune_lookup(m, n, k);
+    gemm_dgemm(m, n, k,
+               (double*)x->data, x->strides[0], x->strides[1],
+               (double*)y->data, y->strides[0], y->strides[1],
+               (double*)out->data, out->strides[0], out->strides[1],
+               0, &config);
 
     return out;
 }
 
 
+// View of the sub-array at start, dropping the first ndim dimensions
 MDArray* mdarray_copy(MDArray* arr, size_t ndim, size_t* start) {
-    MDArray* new_arr = (MDArray*)malloc(sizeof(MDArray));
-    if (!new_arr || !arr) return NULL;
-
-    new_arr->ndim = arr->ndim - ndim;
-    new_arr->itemsize = arr->itemsize;
-
-    // Allocate and copy shape array
-    new_arr->shape = (size_t*)malloc(new_arr->ndim * sizeof(size_t));
-    if (!arr->shape) {
-        free(arr);
-        return NULL;
-    }
-
-    memcpy(new_arr->shape, &arr->shape[ndim], new_arr->ndim * sizeof(size_t));
-
-    // Calculate strides
-    new_arr->strides = (size_t*)malloc(new_arr->ndim * sizeof(size_t));
-    if (!new_arr->strides) {
-        free(new_arr->shape);
-        free(new_arr);
-        return NULL;
-    }
-
-    new_arr->total_size = 1;
-    for (size_t i = 0; i < new_arr->ndim; i++) {
-        new_arr->total_size *= new_arr->shape[i];
-    }
-
-    size_t stride = 1;
-    for (size_t i = new_arr->ndim - 1; i < new_arr->ndim; i--) {
-        new_arr->strides[i] = stride;
-        stride *= new_arr->shape[i];
-    }
+    if (!arr || ndim > arr->ndim) return NULL;
 
     size_t flat_index = 0;
     for (size_t i = 0; i < ndim; i++) {
         flat_index += start[i] * arr->strides[i]; // Find position in old array
     }
 
-    // Start pointer at given index
-    new_arr->data = &arr->data[flat_index];
-    new_arr->owns_data = 0; // This is a view, so it does not own the data
-    if (!new_arr->data) {
-        free(new_arr->strides);
-        free(new_arr->shape);
-        free(new_arr);
-        return NULL;
-    }
-
-    return new_arr;
+    // Start pointer at given index, keeping the parent's strides
+    return mdarray_share(arr, flat_index, arr->ndim - ndim, &arr->shape[ndim], &arr->strides[ndim]);
 }
 
 MDArray* mdarray_resize(MDArray* arr, size_t ndim, size_t* shape) {
-    MDArray* new_arr = (MDArray*)malloc(sizeof(MDArray));
-    if(!new_arr) return NULL;
-
-    new_arr->ndim = ndim;
-    new_arr->itemsize = arr->itemsize;
-    new_arr->total_size = arr->total_size;
-
-    // Allocate and copy shape array
-    new_arr->shape = (size_t*)malloc(ndim * sizeof(size_t));
-    if (!arr->shape) {
-        free(arr);
-        return NULL;
+    size_t total_size = 1;
+    for (size_t i = 0; i < ndim; i++) {
+        total_size *= shape[i];
     }
-    memcpy(new_arr->shape, shape, ndim * sizeof(size_t));
-
-    // Calculate strides
-    new_arr->strides = (size_t*)malloc(ndim * sizeof(size_t));
-    if (!new_arr->strides) {
-        free(new_arr->shape);
-        free(new_arr);
+    if (total_size != arr->total_size) {
+        printf("Cannot resize %zu elements to %zu\n", arr->total_size, total_size);
         return NULL;
     }
 
-    size_t stride = 1;
-    for (size_t i = ndim - 1; i < ndim; i--) {
-        new_arr->strides[i] = stride;
-        stride *= shape[i];
-    }
+    // Reinterpreting the shape needs row-major storage, pack strided views first
+    MDArray* packed = mdarray_contiguous(arr);
+    if (!packed) return NULL;
 
-    new_arr->data = arr->data;
-    new_arr->data = arr->data; // or &arr->data[flat_index]
-    new_arr->owns_data = 0; // This is a view, so it does not own the data
+    MDArray* new_arr = mdarray_share(packed, 0, ndim, shape, NULL);
+    mdarray_free(packed);
 
     return new_arr;
 }
@@ -231,15 +312,24 @@ MDArray* mdarray_sum(MDArray* a, MDArray* b) {
     }
 
     MDArray* out = mdarray_create(a->ndim, a->shape, sizeof(double));
-    if (!out) return NULL;
+    MDArray* pa = mdarray_contiguous(a);
+    MDArray* pb = mdarray_contiguous(b);
+    if (!out || !pa || !pb) {
+        mdarray_free(out);
+        mdarray_free(pa);
+        mdarray_free(pb);
+        return NULL;
+    }
 
     for (size_t i = 0; i < a->total_size; i++) {
-        double x = *(double*)((char*)a->data + i * a->itemsize);
-        double y = *(double*)((char*)b->data + i * b->itemsize);
+        double x = *(double*)((char*)pa->data + i * pa->itemsize);
+        double y = *(double*)((char*)pb->data + i * pb->itemsize);
         double sum = x + y;
         memcpy((char*)out->data + i * a->itemsize, &sum, a->itemsize);
     }
 
+    mdarray_free(pa);
+    mdarray_free(pb);
     return out;
 }
 
@@ -324,16 +414,151 @@ MDArray* mdarray_transpose(MDArray* arr) {
     return transposed;
 }
 
-void mdarray_ones(MDArray* arr) {
+// Writes value to every element of dimension dim and below
+static void mdarray_fill_dim(MDArray* arr, size_t dim, char* dst, double value) {
+    if (dim == arr->ndim) {
+        memcpy(dst, &value, arr->itemsize);
+        return;
+    }
+    for (size_t i = 0; i < arr->shape[dim]; i++) {
+        mdarray_fill_dim(arr, dim + 1, dst + i * arr->strides[dim] * arr->itemsize, value);
+    }
+}
+
+static void mdarray_fill(MDArray* arr, double value) {
+    if (mdarray_make_writable(arr) != 0) return;
+
+    if (!mdarray_is_contiguous(arr)) {
+        mdarray_fill_dim(arr, 0, (char*)arr->data, value);
+        return;
+    }
     for(size_t i = 0; i < arr->total_size; i++) {
-        double x = 1;
-        memcpy((char*)arr->data + (i * arr->itemsize), &x, arr->itemsize);
+        memcpy((char*)arr->data + (i * arr->itemsize), &value, arr->itemsize);
     }
 }
 
+void mdarray_ones(MDArray* arr) {
+    mdarray_fill(arr, 1);
+}
+
 void mdarray_zeros(MDArray* arr) {
-    for(size_t i = 0; i < arr->total_size; i++) {
-        double x = 0;
-        memcpy((char*)arr->data + (i * arr->itemsize), &x, arr->itemsize);
+    mdarray_fill(arr, 0);
+}
+
+MDArray* mdarray_view(MDArray* arr) {
+    return mdarray_share(arr, 0, arr->ndim, arr->shape, arr->strides);
+}
+
+// Elements [start, end) along axis, e.g. a mini-batch of columns
+MDArray* mdarray_slice(MDArray* arr, size_t axis, size_t start, size_t end) {
+    if (axis >= arr->ndim || start > end || end > arr->shape[axis]) {
+        printf("Invalid slice [%zu, %zu) of axis %zu\n", start, end, axis);
+        return NULL;
     }
-}
\ No newline at end of file
+
+    MDArray* view = mdarray_share(arr, start * arr->strides[axis], arr->ndim, arr->shape, arr->strides);
+    if (!view) return NULL;
+
+    view->shape[axis] = end - start;
+    view->total_size = 1;
+    for (size_t i = 0; i < view->ndim; i++) {
+        view->total_size *= view->shape[i];
+    }
+
+    return view;
+}
+
+// Reverses the dimensions by swapping strides, no elements move
+MDArray* mdarray_transpose_view(MDArray* arr) {
+    MDArray* view = mdarray_view(arr);
+    if (!view) return NULL;
+
+    for (size_t i = 0; i < arr->ndim; i++) {
+        view->shape[i] = arr->shape[arr->ndim - 1 - i];
+        view->strides[i] = arr->strides[arr->ndim - 1 - i];
+    }
+
+    return view;
+}
+
+MDArray* mdarray_cow_view(MDArray* arr) {
+    arr->copy_on_write = 1;
+    return mdarray_view(arr);
+}
+
+int mdarray_is_contiguous(MDArray* arr) {
+    size_t expected = 1;
+    for (size_t i = arr->ndim; i > 0; i--) {
+        if (arr->shape[i - 1] != 1 && arr->strides[i - 1] != expected) return 0;
+        expected *= arr->shape[i - 1];
+    }
+    return 1;
+}
+
+// Copies the elements of dimension dim and below to dst in row-major order
+static char* mdarray_pack_dim(MDArray* arr, size_t dim, const char* src, char* dst) {
+    if (dim == arr->ndim) {
+        memcpy(dst, src, arr->itemsize);
+        return dst + arr->itemsize;
+    }
+
+    size_t n = arr->shape[dim];
+    if (dim == arr->ndim - 1 && arr->strides[dim] == 1) {
+        memcpy(dst, src, n * arr->itemsize);
+        return dst + n * arr->itemsize;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        dst = mdarray_pack_dim(arr, dim + 1, src + i * arr->strides[dim] * arr->itemsize, dst);
+    }
+    return dst;
+}
+
+MDArray* mdarray_contiguous(MDArray* arr) {
+    if (mdarray_is_contiguous(arr)) return mdarray_view(arr);
+
+    MDArray* packed = mdarray_create(arr->ndim, arr->shape, arr->itemsize);
+    if (!packed) return NULL;
+
+    mdarray_pack_dim(arr, 0, (const char*)arr->data, (char*)packed->data);
+    return packed;
+}
+
+int mdarray_save_contiguous(MDArray** saved, MDArray* arr) {
+    mdarray_free(*saved);
+    *saved = mdarray_contiguous(arr);
+    return *saved ? 0 : -1;
+}
+
+int mdarray_has_shape(MDArray* arr, size_t ndim, const size_t* shape) {
+    if (arr->ndim != ndim) return 0;
+    for (size_t d = 0; d < ndim; d++) {
+        if (arr->shape[d] != shape[d]) return 0;
+    }
+    return 1;
+}
+
+int mdarray_make_writable(MDArray* arr) {
+    MDBuffer* buffer = arr->buffer;
+    int shared = arr->copy_on_write && atomic_load(&buffer->refcount) > 1;
+    if (!buffer->readonly && !shared) return 0;
+
+    MDBuffer* copy = mdbuffer_create(arr->total_size * arr->itemsize);
+    if (!copy) {
+        printf("Failed to copy array before writing\n");
+        return -1;
+    }
+    mdarray_pack_dim(arr, 0, (const char*)arr->data, (char*)copy->data);
+
+    size_t stride = 1;
+    for (size_t i = arr->ndim - 1; i < arr->ndim; i--) {
+        arr->strides[i] = stride;
+        stride *= arr->shape[i];
+    }
+    arr->data = copy->data;
+    arr->buffer = copy;
+    arr->copy_on_write = 0;
+    mdbuffer_release(buffer);
+
+    return 0;
+}
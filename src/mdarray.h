@@ -2,20 +2,53 @@
 #ifndef MDARRAY_H
 #define MDARRAY_H
 
+#include <stdatomic.h>
 #include <stdio.h>
 
+// Releases the memory of a buffer once its last reference is dropped
+typedef void (*mdbuffer_dealloc_fn)(void* ctx, void* data, size_t bytes);
+
+// Reference-counted storage shared by an array and all of its views.
+// Counts are atomic, so references can be handed between threads.
+typedef struct {
+    void* data;
+    size_t bytes;
+    atomic_size_t refcount;
+    int readonly;                 // Writers must copy first (see mdarray_make_writable)
+    mdbuffer_dealloc_fn dealloc;  // NULL for memory the buffer does not own
+    void* dealloc_ctx;
+    int embedded;                 // 1 if allocated together with an MDArray (mdarray_create)
+} MDBuffer;
+
+// Arrays of up to this many dimensions keep shape and strides inline, so
+// views and small tensors need no allocations besides the MDArray itself
+#define MDARRAY_MAX_INLINE_DIMS 4
+
 // Structure to hold array metadata
 typedef struct {
-    void* data;           // Pointer to contiguous data
-    int owns_data;  // 1 if this instance owns the data, 0 otherwise
+    void* data;           // Pointer to the first element inside buffer
+    MDBuffer* buffer;     // Storage, one reference held by this instance
     size_t* shape;        // Array dimensions
     size_t* strides;      // Number of elements to skip in each dimension
     size_t ndim;          // Number of dimensions
     size_t itemsize;      // Size of each element in bytes
     size_t total_size;    // Total number of elements
+    int copy_on_write;    // 1 if writes must not be seen by other holders of buffer
+    int embedded;         // 1 if allocated together with its first buffer (mdarray_create)
+    // shape and strides point here unless ndim > MDARRAY_MAX_INLINE_DIMS
+    size_t inline_shape[MDARRAY_MAX_INLINE_DIMS];
+    size_t inline_strides[MDARRAY_MAX_INLINE_DIMS];
 } MDArray;
 
+MDBuffer* mdbuffer_create(size_t bytes);
+MDBuffer* mdbuffer_wrap(void* data, size_t bytes, mdbuffer_dealloc_fn dealloc, void* ctx);
+MDBuffer* mdbuffer_retain(MDBuffer* buffer);
+void mdbuffer_release(MDBuffer* buffer);
+
 MDArray* mdarray_create(size_t ndim, size_t* shape, size_t itemsize);
+// View of buffer starting at byte offset, strides NULL means row-major
+MDArray* mdarray_from_buffer(MDBuffer* buffer, size_t offset, size_t ndim, size_t* shape,
+                             size_t* strides, size_t itemsize);
 void mdarray_free(MDArray* arr);
 void* mdarray_get_element(MDArray* arr, size_t* indices);
 void mdarray_set_element(MDArray* arr, size_t* indices, void* value);
@@ -29,4 +62,26 @@ MDArray* mdarray_sum(MDArray* a, MDArray* b);
 MDArray* mdarray_transpose(MDArray* arr);
 MDArray* mdarray_sum_along_axis(MDArray* arr, size_t axis);
 
+// Zero-copy views, each holds its own reference to the shared buffer and
+// stays valid after the array it was taken from is freed
+MDArray* mdarray_view(MDArray* arr);
+MDArray* mdarray_slice(MDArray* arr, size_t axis, size_t start, size_t end);
+MDArray* mdarray_transpose_view(MDArray* arr);
+// View whose writes detach it (and arr) from the shared buffer first
+MDArray* mdarray_cow_view(MDArray* arr);
+
+int mdarray_is_contiguous(MDArray* arr);
+// Row-major array with the same elements: a view when arr already is one,
+// otherwise a packed copy. The caller frees the result either way.
+MDArray* mdarray_contiguous(MDArray* arr);
+// Replaces *saved with mdarray_contiguous(arr), the way layers keep their
+// input for backward: zero-copy unless arr is a strided view. Returns -1,
+// leaving *saved NULL, if packing fails.
+int mdarray_save_contiguous(MDArray** saved, MDArray* arr);
+// 1 if arr has exactly these ndim dimensions
+int mdarray_has_shape(MDArray* arr, size_t ndim, const size_t* shape);
+// Gives arr a private copy of its elements when the buffer is read-only or
+// shared copy-on-write. Returns 0 on success, -1 if the copy failed.
+int mdarray_make_writable(MDArray* arr);
+
 #endif // MDARRAY_H
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "parallel.h"
+#include "scheduler.h"
+
+// 0 means not configured yet: use NNC_NUM_THREADS or the number of online CPUs
+static size_t num_threads = 0;
+
+typedef struct {
+    parallel_fn fn;
+    void* ctx;
+    size_t begin;
+    size_t end;
+} ParallelChunk;
+
+size_t parallel_num_threads(void) {
+    if (num_threads == 0) {
+        const char* env = getenv("NNC_NUM_THREADS");
+        long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = n > 0 ? (size_t)n : 1;
+    }
+    return num_threads;
+}
+
+void parallel_set_num_threads(size_t n) {
+    num_threads = n;
+}
+
+static void parallel_run_chunk(void* arg) {
+    ParallelChunk* chunk = (ParallelChunk*)arg;
+    chunk->fn(chunk->ctx, chunk->begin, chunk->end);
+}
+
+void parallel_for(size_t n, size_t grain, parallel_fn fn, void* ctx) {
+    if (n == 0) return;
+    if (grain == 0) grain = 1;
+
+    size_t n_chunks = (n + grain - 1) / grain;
+    if (n_chunks > parallel_num_threads()) n_chunks = parallel_num_threads();
+    if (n_chunks <= 1) {
+        fn(ctx, 0, n);
+        return;
+    }
+
+    ParallelChunk* chunks = (ParallelChunk*)malloc(n_chunks * sizeof(ParallelChunk));
+    Task** tasks = (Task**)calloc(n_chunks, sizeof(Task*));
+    if (!chunks || !tasks) {
+        free(chunks);
+        free(tasks);
+        fn(ctx, 0, n);
+        return;
+    }
+
+    size_t per_chunk = (n + n_chunks - 1) / n_chunks;
+    for (size_t c = 0; c < n_chunks; c++) {
+        chunks[c].fn = fn;
+        chunks[c].ctx = ctx;
+        chunks[c].begin = c * per_chunk < n ? c * per_chunk : n;
+        chunks[c].end = (c + 1) * per_chunk < n ? (c + 1) * per_chunk : n;
+    }
+
+    // Chunks go to the scheduler, idle workers steal them while chunk 0
+    // runs on the calling thread. Nested loops are fine since waiting
+    // threads keep running queued tasks.
+    for (size_t c = 1; c < n_chunks; c++) {
+        tasks[c] = task_create(parallel_run_chunk, &chunks[c]);
+        if (tasks[c]) task_submit(tasks[c]);
+    }
+    parallel_run_chunk(&chunks[0]);
+    for (size_t c = 1; c < n_chunks; c++) {
+        if (tasks[c]) {
+            task_wait(tasks[c]);
+            task_release(tasks[c]);
+        } else {
+            parallel_run_chunk(&chunks[c]);
+        }
+    }
+
+    free(tasks);
+    free(chunks);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+
+// parallel_fn processes the half-open range [begin, end) of a parallel loop
+typedef void (*parallel_fn)(void* ctx, size_t begin, size_t end);
+
+size_t parallel_num_threads(void);
+// Changes how many chunks parallel_for splits into. The scheduler's worker
+// pool is sized once, from the value in effect when it first starts.
+void parallel_set_num_threads(size_t num_threads);
+
+// parallel_for splits [0, n) into contiguous chunks of at least grain
+// iterations, at most parallel_num_threads() of them, and runs them as
+// scheduler tasks.
+// Returns once every chunk has finished.
+void parallel_for(size_t n, size_t grain, parallel_fn fn, void* ctx);
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+#include "pool.h"
+
+typedef struct {
+    Pool2DLayer* layer;
+    size_t h, w, c, out_h, out_w;
+    const double* input;
+    const double* grad_output;
+    double* output;
+    double* grad_input;
+} PoolTask;
+
+Pool2DLayer* pool2d_create(PoolType type, size_t kernel_size, size_t stride) {
+    Pool2DLayer* layer = malloc(sizeof(Pool2DLayer));
+    if (!layer) return NULL;
+
+    layer->type = type;
+    layer->kernel_size = kernel_size;
+    layer->stride = stride ? stride : kernel_size;
+    layer->input = NULL;
+    layer->argmax = NULL;
+    layer->argmax_size = 0;
+
+    return layer;
+}
+
+void pool2d_free(Pool2DLayer* layer) {
+    if (layer) {
+        mdarray_free(layer->input);
+        free(layer->argmax);
+        free(layer);
+    }
+}
+
+// Dimensions of pooling input [n, h, w, c] into t, or -1 if it cannot be pooled
+static int pool_shape(Pool2DLayer* layer, MDArray* input, PoolTask* t) {
+    if (input->ndim != 4) {
+        printf("Pool2D input must be NHWC (4 dimensions)\n");
+        return -1;
+    }
+    if (input->shape[1] < layer->kernel_size || input->shape[2] < layer->kernel_size) {
+        printf("Pool2D kernel larger than input\n");
+        return -1;
+    }
+
+    t->layer = layer;
+    t->h = input->shape[1];
+    t->w = input->shape[2];
+    t->c = input->shape[3];
+    t->out_h = (t->h - layer->kernel_size) / layer->stride + 1;
+    t->out_w = (t->w - layer->kernel_size) / layer->stride + 1;
+    return 0;
+}
+
+// Images [begin, end): each output keeps the max (or mean) of its window
+static void pool_forward_range(void* ctx, size_t begin, size_t end) {
+    PoolTask* t = (PoolTask*)ctx;
+    Pool2DLayer* layer = t->layer;
+    size_t k = layer->kernel_size;
+    double scale = 1.0 / (double)(k * k);
+
+    for (size_t n = begin; n < end; n++) {
+        for (size_t oh = 0; oh < t->out_h; oh++) {
+            for (size_t ow = 0; ow < t->out_w; ow++) {
+                size_t out_offset = ((n * t->out_h + oh) * t->out_w + ow) * t->c;
+                for (size_t ch = 0; ch < t->c; ch++) {
+                    size_t best = ((n * t->h + oh * layer->stride) * t->w + ow * layer->stride) * t->c + ch;
+                    double acc = layer->type == POOL_MAX ? t->input[best] : 0.0;
+
+                    for (size_t kh = 0; kh < k; kh++) {
+                        for (size_t kw = 0; kw < k; kw++) {
+                            size_t ih = oh * layer->stride + kh;
+                            size_t iw = ow * layer->stride + kw;
+                            size_t offset = ((n * t->h + ih) * t->w + iw) * t->c + ch;
+                            double x = t->input[offset];
+                            if (layer->type == POOL_AVG) {
+                                acc += x;
+                            } else if (x > acc) {
+                                acc = x;
+                                best = offset;
+                            }
+                        }
+                    }
+
+                    if (layer->type == POOL_MAX) {
+                        layer->argmax[out_offset + ch] = best;
+                        t->output[out_offset + ch] = acc;
+                    } else {
+                        t->output[out_offset + ch] = acc * scale;
+                    }
+                }
+            }
+        }
+    }
+}
+
+MDArray* pool2d_forward(Pool2DLayer* layer, MDArray* input) {
+    PoolTask t;
+    if (pool_shape(layer, input, &t) != 0) return NULL;
+
+    size_t out_shape[] = {input->shape[0], t.out_h, t.out_w, t.c};
+    MDArray* out = mdarray_create(4, out_shape, sizeof(double));
+    if (!out) return NULL;
+
+    if (layer->type == POOL_MAX && layer->argmax_size != out->total_size) {
+        free(layer->argmax);
+        layer->argmax = malloc(out->total_size * sizeof(size_t));
+        layer->argmax_size = layer->argmax ? out->total_size : 0;
+        if (!layer->argmax) {
+            mdarray_free(out);
+            return NULL;
+        }
+    }
+
+    if (mdarray_save_contiguous(&layer->input, input) != 0) {
+        mdarray_free(out);
+        return NULL;
+    }
+
+    t.input = (const double*)layer->input->data;
+    t.output = (double*)out->data;
+    parallel_for(input->shape[0], 1, pool_forward_range, &t);
+
+    return out;
+}
+
+// Images [begin, end): windows never cross images, so writes don't race
+static void pool_backward_range(void* ctx, size_t begin, size_t end) {
+    PoolTask* t = (PoolTask*)ctx;
+    Pool2DLayer* layer = t->layer;
+    size_t k = layer->kernel_size;
+    size_t per_image = t->out_h * t->out_w * t->c;
+    double scale = 1.0 / (double)(k * k);
+
+    for (size_t n = begin; n < end; n++) {
+        for (size_t i = n * per_image; i < (n + 1) * per_image; i++) {
+            if (layer->type == POOL_MAX) {
+                t->grad_input[layer->argmax[i]] += t->grad_output[i];
+                continue;
+            }
+
+            size_t ch = i % t->c;
+            size_t ow = (i / t->c) % t->out_w;
+            size_t oh = (i / t->c / t->out_w) % t->out_h;
+            for (size_t kh = 0; kh < k; kh++) {
+                for (size_t kw = 0; kw < k; kw++) {
+                    size_t ih = oh * layer->stride + kh;
+                    size_t iw = ow * layer->stride + kw;
+                    t->grad_input[((n * t->h + ih) * t->w + iw) * t->c + ch] += t->grad_output[i] * scale;
+                }
+            }
+        }
+    }
+}
+
+MDArray* pool2d_backward(Pool2DLayer* layer, MDArray* grad_output) {
+    PoolTask t;
+    if (!layer->input || pool_shape(layer, layer->input, &t) != 0) return NULL;
+
+    size_t out_shape[] = {layer->input->shape[0], t.out_h, t.out_w, t.c};
+    if (!mdarray_has_shape(grad_output, 4, out_shape)) {
+        printf("Pool2D gradient must match the last output [%zu, %zu, %zu, %zu]\n",
+               out_shape[0], t.out_h, t.out_w, t.c);
+        return NULL;
+    }
+
+    MDArray* dy = mdarray_contiguous(grad_output);
+    MDArray* grad_input = dy ? mdarray_create(4, layer->input->shape, sizeof(double)) : NULL;
+    if (!grad_input) {
+        mdarray_free(dy);
+        return NULL;
+    }
+    mdarray_zeros(grad_input);
+
+    t.grad_output = (const double*)dy->data;
+    t.grad_input = (double*)grad_input->data;
+    parallel_for(layer->input->shape[0], 1, pool_backward_range, &t);
+
+    mdarray_free(dy);
+    return grad_input;
+}
+
+void pool2d_release_input(Pool2DLayer* layer) {
+    mdarray_free(layer->input);
+    layer->input = NULL;
+    free(layer->argmax);
+    layer->argmax = NULL;
+    layer->argmax_size = 0;
+}
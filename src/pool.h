@@ -0,0 +1,28 @@
+#pragma once
+
+#include "mdarray.h"
+
+typedef enum {
+    POOL_MAX,
+    POOL_AVG
+} PoolType;
+
+// 2D pooling over NHWC activations, no padding
+typedef struct {
+    PoolType type;
+    size_t kernel_size;
+    size_t stride;
+    MDArray* input;     // [n, h, w, c] saved for backward (holds a reference)
+    size_t* argmax;     // Input offset of each output's maximum (POOL_MAX)
+    size_t argmax_size;
+} Pool2DLayer;
+
+Pool2DLayer* pool2d_create(PoolType type, size_t kernel_size, size_t stride);
+void pool2d_free(Pool2DLayer* layer);
+
+// input   [n, h, w, c]
+// RETURNS [n, out_h, out_w, c]
+MDArray* pool2d_forward(Pool2DLayer* layer, MDArray* input);
+MDArray* pool2d_backward(Pool2DLayer* layer, MDArray* grad_output);
+// Drops the input and argmax saved by the last forward
+void pool2d_release_input(Pool2DLayer* layer);
@@ -0,0 +1,191 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+// Elements per parallel chunk, small fills stay on the calling thread
+#define RNG_GRAIN 16384
+
+// Redraws for truncated normal before giving up and clamping
+#define RNG_MAX_ATTEMPTS 64
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef enum {
+    RNG_UNIFORM,
+    RNG_NORMAL,
+    RNG_TRUNCATED_NORMAL,
+    RNG_DROPOUT
+} RNGKind;
+
+typedef struct {
+    RNGKind kind;
+    double* data;
+    uint32_t key[2];
+    uint64_t counter;
+    double a;
+    double b;
+} RNGFill;
+
+RNG rng_new(uint64_t seed) {
+    RNG rng = {seed, 0};
+    return rng;
+}
+
+void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t x0 = counter[0], x1 = counter[1], x2 = counter[2], x3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * x0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * x2;
+        uint32_t y0 = (uint32_t)(p1 >> 32) ^ x1 ^ k0;
+        uint32_t y2 = (uint32_t)(p0 >> 32) ^ x3 ^ k1;
+        x0 = y0;
+        x1 = (uint32_t)p1;
+        x2 = y2;
+        x3 = (uint32_t)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = x0;
+    out[1] = x1;
+    out[2] = x2;
+    out[3] = x3;
+}
+
+// Uniform double in (0, 1] from 53 random bits, never 0 so log() is safe
+static double rng_to_unit(uint32_t hi, uint32_t lo) {
+    uint64_t bits = (((uint64_t)hi << 32) | lo) >> 11;
+    return ((double)bits + 1.0) * (1.0 / 9007199254740992.0);
+}
+
+// rng_draw returns two uniforms for element index of the stream, attempt
+// selects an independent draw for rejection sampling
+static void rng_draw(const uint32_t key[2], uint64_t index, uint32_t attempt, double* u0, double* u1) {
+    uint32_t counter[4] = {(uint32_t)index, (uint32_t)(index >> 32), attempt, 0};
+    uint32_t out[4];
+    philox4x32(counter, key, out);
+    *u0 = rng_to_unit(out[0], out[1]);
+    *u1 = rng_to_unit(out[2], out[3]);
+}
+
+static double rng_box_muller(double u0, double u1) {
+    return sqrt(-2.0 * log(u0)) * cos(2.0 * M_PI * u1);
+}
+
+// One loop per distribution keeps the bodies branch-free so the compiler
+// can vectorize the Philox rounds
+static void rng_fill_range(void* ctx, size_t begin, size_t end) {
+    RNGFill* fill = (RNGFill*)ctx;
+    double* data = fill->data;
+    double a = fill->a;
+    double b = fill->b;
+    double u0, u1;
+
+    switch (fill->kind) {
+    case RNG_UNIFORM:
+        for (size_t i = begin; i < end; i++) {
+            rng_draw(fill->key, fill->counter + i, 0, &u0, &u1);
+            data[i] = a + (b - a) * (1.0 - u0);
+        }
+        break;
+    case RNG_NORMAL:
+        for (size_t i = begin; i < end; i++) {
+            rng_draw(fill->key, fill->counter + i, 0, &u0, &u1);
+            data[i] = a + b * rng_box_muller(u0, u1);
+        }
+        break;
+    case RNG_TRUNCATED_NORMAL:
+        for (size_t i = begin; i < end; i++) {
+            double z = 0.0;
+            for (uint32_t attempt = 0; attempt < RNG_MAX_ATTEMPTS; attempt++) {
+                rng_draw(fill->key, fill->counter + i, attempt, &u0, &u1);
+                z = rng_box_muller(u0, u1);
+                if (fabs(z) <= 2.0) break;
+            }
+            if (z > 2.0) z = 2.0;
+            if (z < -2.0) z = -2.0;
+            data[i] = a + b * z;
+        }
+        break;
+    case RNG_DROPOUT:
+        for (size_t i = begin; i < end; i++) {
+            rng_draw(fill->key, fill->counter + i, 0, &u0, &u1);
+            data[i] = (1.0 - u0) < a ? 0.0 : b;
+        }
+        break;
+    }
+}
+
+static void rng_fill(RNG* rng, MDArray* arr, RNGKind kind, double a, double b) {
+    if (mdarray_make_writable(arr) != 0) return;
+    if (!mdarray_is_contiguous(arr)) {
+        printf("RNG fills need a contiguous array\n");
+        return;
+    }
+
+    RNGFill fill;
+    fill.kind = kind;
+    fill.data = (double*)arr->data;
+    fill.key[0] = (uint32_t)rng->seed;
+    fill.key[1] = (uint32_t)(rng->seed >> 32);
+    fill.counter = rng->counter;
+    fill.a = a;
+    fill.b = b;
+
+    parallel_for(arr->total_size, RNG_GRAIN, rng_fill_range, &fill);
+    rng->counter += arr->total_size;
+}
+
+void rng_uniform(RNG* rng, MDArray* arr, double low, double high) {
+    rng_fill(rng, arr, RNG_UNIFORM, low, high);
+}
+
+void rng_normal(RNG* rng, MDArray* arr, double mean, double stddev) {
+    rng_fill(rng, arr, RNG_NORMAL, mean, stddev);
+}
+
+void rng_truncated_normal(RNG* rng, MDArray* arr, double mean, double stddev) {
+    rng_fill(rng, arr, RNG_TRUNCATED_NORMAL, mean, stddev);
+}
+
+void rng_dropout_mask(RNG* rng, MDArray* mask, double p) {
+    rng_fill(rng, mask, RNG_DROPOUT, p, p < 1.0 ? 1.0 / (1.0 - p) : 0.0);
+}
+
+size_t* rng_permutation(RNG* rng, size_t n) {
+    size_t* perm = (size_t*)malloc((n ? n : 1) * sizeof(size_t));
+    if (!perm) return NULL;
+
+    for (size_t i = 0; i < n; i++) {
+        perm[i] = i;
+    }
+
+    // Fisher-Yates, step i draws from counter + i
+    uint32_t key[2] = {(uint32_t)rng->seed, (uint32_t)(rng->seed >> 32)};
+    double u0, u1;
+    for (size_t i = n; i > 1; i--) {
+        rng_draw(key, rng->counter + i - 1, 0, &u0, &u1);
+        size_t j = (size_t)((1.0 - u0) * (double)i);
+        if (j >= i) j = i - 1;
+
+        size_t tmp = perm[i - 1];
+        perm[i - 1] = perm[j];
+        perm[j] = tmp;
+    }
+
+    rng->counter += n;
+    return perm;
+}
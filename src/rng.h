@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mdarray.h"
+
+// Counter-based random number stream (Philox4x32-10).
+// Every generated value is a pure function of (seed, counter), so fills are
+// split across threads freely and still give the same result for a seed
+// regardless of the thread count. Each call consumes one counter per element
+// and advances the stream, so successive calls draw different values.
+typedef struct {
+    uint64_t seed;
+    uint64_t counter;
+} RNG;
+
+// Standard deviation of a unit normal truncated at +-2. Dividing stddev by
+// it makes rng_truncated_normal samples spread as much as intended.
+#define RNG_TRUNCATED_STDDEV 0.87962566103423978
+
+RNG rng_new(uint64_t seed);
+void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+
+void rng_uniform(RNG* rng, MDArray* arr, double low, double high);
+void rng_normal(RNG* rng, MDArray* arr, double mean, double stddev);
+// Samples farther than two standard deviations from the mean are redrawn,
+// which narrows the spread to RNG_TRUNCATED_STDDEV times stddev
+void rng_truncated_normal(RNG* rng, MDArray* arr, double mean, double stddev);
+// Inverted dropout: each element is 0 with probability p, 1 / (1 - p) otherwise
+void rng_dropout_mask(RNG* rng, MDArray* mask, double p);
+// Returns a random permutation of [0, n), the caller frees it
+size_t* rng_permutation(RNG* rng, size_t n);
@@ -0,0 +1,281 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+#include "scheduler.h"
+
+#define SCHEDULER_DEQUE_CAPACITY 64
+
+struct Task {
+    task_fn fn;
+    void* ctx;
+    atomic_size_t pending;      // Unfinished dependencies, plus one until submitted
+    atomic_size_t refcount;     // Caller's reference plus the scheduler's while submitted
+    atomic_int done;
+    Task** dependents;          // Tasks waiting on this one, guarded by graph_lock
+    size_t n_dependents;
+    size_t dependents_capacity;
+};
+
+// Ring buffer, the owning worker uses the bottom and thieves the top
+typedef struct {
+    pthread_mutex_t lock;
+    Task** tasks;
+    size_t top;
+    size_t count;
+    size_t capacity;
+} TaskDeque;
+
+static pthread_once_t scheduler_once = PTHREAD_ONCE_INIT;
+static size_t num_workers;
+static TaskDeque* deques;       // One per worker, then the queue shared by other threads
+static size_t num_deques;
+
+static pthread_mutex_t graph_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static atomic_size_t queued;    // Tasks sitting in any deque
+
+// Deque of the calling worker, the shared queue for any other thread
+static _Thread_local size_t own_deque = (size_t)-1;
+
+static int deque_push(TaskDeque* d, Task* task) {
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->capacity) {
+        size_t capacity = d->capacity ? d->capacity * 2 : SCHEDULER_DEQUE_CAPACITY;
+        Task** tasks = (Task**)malloc(capacity * sizeof(Task*));
+        if (!tasks) {
+            pthread_mutex_unlock(&d->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < d->count; i++) {
+            tasks[i] = d->tasks[(d->top + i) % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->top = 0;
+        d->capacity = capacity;
+    }
+    d->tasks[(d->top + d->count) % d->capacity] = task;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+// Newest task, keeps the owner on the data it just touched
+static Task* deque_pop_bottom(TaskDeque* d) {
+    Task* task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        d->count--;
+        task = d->tasks[(d->top + d->count) % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+// Oldest task, usually the largest piece of remaining work
+static Task* deque_steal_top(TaskDeque* d) {
+    Task* task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        task = d->tasks[d->top];
+        d->top = (d->top + 1) % d->capacity;
+        d->count--;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static Task* scheduler_find(void) {
+    if (atomic_load(&queued) == 0) return NULL;
+
+    size_t self = own_deque < num_workers ? own_deque : num_workers;
+    Task* task = self < num_workers ? deque_pop_bottom(&deques[self]) : NULL;
+    for (size_t i = 0; !task && i < num_deques; i++) {
+        task = deque_steal_top(&deques[(self + 1 + i) % num_deques]);
+    }
+
+    if (task) atomic_fetch_sub(&queued, 1);
+    return task;
+}
+
+static void task_run(Task* task);
+
+static void task_enqueue(Task* task) {
+    if (num_deques == 0) {
+        task_run(task);
+        return;
+    }
+    size_t self = own_deque < num_workers ? own_deque : num_workers;
+
+    // Count first so a thief never sees a task that queued does not include
+    atomic_fetch_add(&queued, 1);
+    if (deque_push(&deques[self], task) != 0) {
+        atomic_fetch_sub(&queued, 1);
+        task_run(task);
+        return;
+    }
+
+    pthread_mutex_lock(&sleep_lock);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&sleep_lock);
+}
+
+// Drops one pending count, queues the task when nothing is left to wait for
+static void task_ready(Task* task) {
+    if (atomic_fetch_sub(&task->pending, 1) == 1) task_enqueue(task);
+}
+
+static void task_run(Task* task) {
+    task->fn(task->ctx);
+
+    pthread_mutex_lock(&graph_lock);
+    atomic_store(&task->done, 1);
+    Task** dependents = task->dependents;
+    size_t n_dependents = task->n_dependents;
+    task->dependents = NULL;
+    task->n_dependents = 0;
+    task->dependents_capacity = 0;
+    pthread_mutex_unlock(&graph_lock);
+
+    for (size_t i = 0; i < n_dependents; i++) {
+        task_ready(dependents[i]);
+    }
+    free(dependents);
+
+    // Waiters sleep on the same condition as idle workers
+    pthread_mutex_lock(&sleep_lock);
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&sleep_lock);
+
+    task_release(task);
+}
+
+static void* scheduler_worker(void* arg) {
+    own_deque = (size_t)arg;
+
+    for (;;) {
+        Task* task = scheduler_find();
+        if (task) {
+            task_run(task);
+            continue;
+        }
+
+        pthread_mutex_lock(&sleep_lock);
+        while (atomic_load(&queued) == 0) {
+            pthread_cond_wait(&wake, &sleep_lock);
+        }
+        pthread_mutex_unlock(&sleep_lock);
+    }
+
+    return NULL;
+}
+
+static void scheduler_start(void) {
+    size_t workers = parallel_num_threads() - 1;
+
+    // Without deques every task runs inline on the thread that queues it
+    deques = (TaskDeque*)calloc(workers + 1, sizeof(TaskDeque));
+    if (!deques) return;
+
+    num_workers = workers;
+    num_deques = workers + 1;
+    for (size_t i = 0; i < num_deques; i++) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+    }
+
+    // A worker that fails to start leaves an empty deque behind, its
+    // share of the work is picked up by waiting threads instead
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (size_t i = 0; i < workers; i++) {
+        pthread_t thread;
+        pthread_create(&thread, &attr, scheduler_worker, (void*)i);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+size_t scheduler_num_workers(void) {
+    pthread_once(&scheduler_once, scheduler_start);
+    return num_workers;
+}
+
+Task* task_create(task_fn fn, void* ctx) {
+    pthread_once(&scheduler_once, scheduler_start);
+
+    Task* task = (Task*)malloc(sizeof(Task));
+    if (!task) return NULL;
+
+    task->fn = fn;
+    task->ctx = ctx;
+    atomic_init(&task->pending, 1);
+    atomic_init(&task->refcount, 1);
+    atomic_init(&task->done, 0);
+    task->dependents = NULL;
+    task->n_dependents = 0;
+    task->dependents_capacity = 0;
+
+    return task;
+}
+
+int task_depends_on(Task* task, Task* dependency) {
+    pthread_mutex_lock(&graph_lock);
+
+    // Nothing to wait for once the dependency has run
+    if (atomic_load(&dependency->done)) {
+        pthread_mutex_unlock(&graph_lock);
+        return 0;
+    }
+
+    if (dependency->n_dependents == dependency->dependents_capacity) {
+        size_t capacity = dependency->dependents_capacity ? dependency->dependents_capacity * 2 : 4;
+        Task** dependents = (Task**)realloc(dependency->dependents, capacity * sizeof(Task*));
+        if (!dependents) {
+            pthread_mutex_unlock(&graph_lock);
+            return -1;
+        }
+        dependency->dependents = dependents;
+        dependency->dependents_capacity = capacity;
+    }
+    dependency->dependents[dependency->n_dependents++] = task;
+    atomic_fetch_add(&task->pending, 1);
+
+    pthread_mutex_unlock(&graph_lock);
+    return 0;
+}
+
+void task_submit(Task* task) {
+    // The scheduler's reference, dropped once the task has run
+    atomic_fetch_add(&task->refcount, 1);
+    task_ready(task);
+}
+
+void task_wait(Task* task) {
+    while (!atomic_load(&task->done)) {
+        Task* other = scheduler_find();
+        if (other) {
+            task_run(other);
+            continue;
+        }
+
+        pthread_mutex_lock(&sleep_lock);
+        while (!atomic_load(&task->done) && atomic_load(&queued) == 0) {
+            pthread_cond_wait(&wake, &sleep_lock);
+        }
+        pthread_mutex_unlock(&sleep_lock);
+    }
+}
+
+int task_done(Task* task) {
+    return atomic_load(&task->done);
+}
+
+void task_release(Task* task) {
+    if (task && atomic_fetch_sub(&task->refcount, 1) == 1) {
+        free(task->dependents);
+        free(task);
+    }
+}
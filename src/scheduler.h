@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+// Work-stealing task scheduler.
+// Each worker thread owns a deque: it pushes and pops its own tasks at the
+// bottom and steals from the top of the others' when it runs dry. Threads
+// that are not workers submit to a shared queue. A thread blocked in
+// task_wait runs queued tasks until the one it waits for has finished, so
+// tasks may submit and wait for other tasks without deadlocking.
+
+typedef struct Task Task;
+typedef void (*task_fn)(void* ctx);
+
+// Starts parallel_num_threads() - 1 workers on first use, the thread
+// waiting on a task is the remaining one
+size_t scheduler_num_workers(void);
+
+// Returns a task holding one reference for the caller, NULL on failure
+Task* task_create(task_fn fn, void* ctx);
+// task does not start before dependency has finished.
+// Call before submitting task. Returns 0 on success, -1 on failure.
+int task_depends_on(Task* task, Task* dependency);
+// Queues task once all of its dependencies have finished
+void task_submit(Task* task);
+// Returns once task has finished, running other tasks meanwhile.
+// task must have been submitted.
+void task_wait(Task* task);
+int task_done(Task* task);
+// Drops the caller's reference. A submitted task still runs, and is
+// freed once it has finished.
+void task_release(Task* task);
@@ -0,0 +1,480 @@
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mdarray.h"
+#include "rng.h"
+#include "server.h"
+
+#define SERVER_BACKLOG 128
+#define SERVER_MAX_CONNECTIONS 1024
+#define SERVER_POLL_MS 100
+
+// One in-flight sample, owned by the connection thread that submitted it
+typedef struct Request {
+    const double* input;
+    double* output;
+    struct timespec arrival;
+    int done;
+    pthread_cond_t done_cond;
+    struct Request* next;
+} Request;
+
+typedef struct {
+    LinearLayer* layer;
+    ServerConfig config;
+    size_t in_features;
+    size_t out_features;
+
+    pthread_mutex_t lock;      // Guards everything below
+    pthread_cond_t queue_cond; // Signalled when a request arrives or on shutdown
+    pthread_cond_t idle_cond;  // Signalled when a connection closes
+    Request* head;
+    Request* tail;
+    size_t queued;
+    int batcher_exit;
+    int connection_fds[SERVER_MAX_CONNECTIONS];
+    size_t connections;
+} Server;
+
+typedef struct {
+    Server* server;
+    int fd;
+} Connection;
+
+static atomic_int stop_requested;
+static atomic_size_t served_requests;
+static atomic_size_t served_batches;
+static atomic_size_t largest_batch;
+
+ServerConfig server_default_config(const char* socket_path) {
+    ServerConfig config = {socket_path, SERVER_MAX_BATCH, SERVER_MAX_DELAY_US};
+    return config;
+}
+
+void server_stop(void) {
+    atomic_store(&stop_requested, 1);
+}
+
+ServerStats server_stats(void) {
+    ServerStats stats;
+    stats.requests = atomic_load(&served_requests);
+    stats.batches = atomic_load(&served_batches);
+    stats.largest_batch = atomic_load(&largest_batch);
+    return stats;
+}
+
+static int read_full(int fd, void* buf, size_t bytes) {
+    char* p = (char*)buf;
+    while (bytes > 0) {
+        ssize_t n = recv(fd, p, bytes, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        bytes -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void* buf, size_t bytes) {
+    const char* p = (const char*)buf;
+    while (bytes > 0) {
+        ssize_t n = send(fd, p, bytes, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        bytes -= (size_t)n;
+    }
+    return 0;
+}
+
+static void add_us(struct timespec* ts, long us) {
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static double elapsed_us(const struct timespec* start, const struct timespec* end) {
+    return (double)(end->tv_sec - start->tv_sec) * 1e6 + (double)(end->tv_nsec - start->tv_nsec) * 1e-3;
+}
+
+// Gather the requests into one [in_features, n] input, run a single
+// forward pass and scatter the output columns back
+static void server_run_batch(Server* server, Request** batch, size_t n) {
+    size_t in = server->in_features;
+    size_t out_features = server->out_features;
+
+    size_t shape[] = {in, n};
+    MDArray* input = mdarray_create(2, shape, sizeof(double));
+    MDArray* out = NULL;
+    if (input) {
+        double* data = (double*)input->data;
+        for (size_t b = 0; b < n; b++) {
+            for (size_t f = 0; f < in; f++) {
+                data[f * n + b] = batch[b]->input[f];
+            }
+        }
+        out = linear_forward(server->layer, input);
+    }
+
+    for (size_t b = 0; b < n; b++) {
+        for (size_t o = 0; o < out_features; o++) {
+            batch[b]->output[o] = out ? ((double*)out->data)[o * n + b] : NAN;
+        }
+    }
+
+    mdarray_free(out);
+    mdarray_free(input);
+}
+
+static void* server_batcher(void* arg) {
+    Server* server = (Server*)arg;
+    Request** batch = (Request**)malloc(server->config.max_batch * sizeof(Request*));
+    if (!batch) return NULL;
+
+    pthread_mutex_lock(&server->lock);
+    while (1) {
+        while (!server->head && !server->batcher_exit) {
+            pthread_cond_wait(&server->queue_cond, &server->lock);
+        }
+        if (!server->head) break;
+
+        // Wait for a full batch, but never past the oldest request's deadline.
+        // Once every connection has a request queued no more can arrive.
+        struct timespec deadline = server->head->arrival;
+        add_us(&deadline, server->config.max_delay_us);
+        while (server->queued < server->config.max_batch && server->queued < server->connections &&
+               !server->batcher_exit) {
+            if (pthread_cond_timedwait(&server->queue_cond, &server->lock, &deadline) == ETIMEDOUT) break;
+        }
+
+        size_t n = 0;
+        while (server->head && n < server->config.max_batch) {
+            batch[n++] = server->head;
+            server->head = server->head->next;
+            server->queued--;
+        }
+        if (!server->head) server->tail = NULL;
+        pthread_mutex_unlock(&server->lock);
+
+        server_run_batch(server, batch, n);
+        atomic_fetch_add(&served_requests, n);
+        atomic_fetch_add(&served_batches, 1);
+        if (n > atomic_load(&largest_batch)) atomic_store(&largest_batch, n);
+
+        pthread_mutex_lock(&server->lock);
+        for (size_t b = 0; b < n; b++) {
+            batch[b]->done = 1;
+            pthread_cond_signal(&batch[b]->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    free(batch);
+    return NULL;
+}
+
+static void server_remove_connection(Server* server, int fd) {
+    pthread_mutex_lock(&server->lock);
+    for (size_t i = 0; i < server->connections; i++) {
+        if (server->connection_fds[i] == fd) {
+            server->connection_fds[i] = server->connection_fds[--server->connections];
+            break;
+        }
+    }
+    pthread_cond_broadcast(&server->idle_cond);
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void* server_connection(void* arg) {
+    Connection* conn = (Connection*)arg;
+    Server* server = conn->server;
+    size_t in_bytes = server->in_features * sizeof(double);
+    size_t out_bytes = server->out_features * sizeof(double);
+
+    double* input = (double*)malloc(in_bytes);
+    double* output = (double*)malloc(out_bytes);
+
+    Request request;
+    request.input = input;
+    request.output = output;
+    pthread_cond_init(&request.done_cond, NULL);
+
+    while (input && output && read_full(conn->fd, input, in_bytes) == 0) {
+        request.done = 0;
+        request.next = NULL;
+        clock_gettime(CLOCK_MONOTONIC, &request.arrival);
+
+        pthread_mutex_lock(&server->lock);
+        if (server->tail) {
+            server->tail->next = &request;
+        } else {
+            server->head = &request;
+        }
+        server->tail = &request;
+        server->queued++;
+        pthread_cond_signal(&server->queue_cond);
+        while (!request.done) {
+            pthread_cond_wait(&request.done_cond, &server->lock);
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        if (write_full(conn->fd, output, out_bytes) != 0) break;
+    }
+
+    pthread_cond_destroy(&request.done_cond);
+    free(input);
+    free(output);
+    server_remove_connection(server, conn->fd);
+    close(conn->fd);
+    free(conn);
+    return NULL;
+}
+
+static int server_listen(const char* path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Error creating socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+        perror("Error binding socket");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void server_accept(Server* server, int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    pthread_mutex_lock(&server->lock);
+    int full = server->connections == SERVER_MAX_CONNECTIONS;
+    if (!full) server->connection_fds[server->connections++] = fd;
+    pthread_mutex_unlock(&server->lock);
+
+    Connection* conn = full ? NULL : (Connection*)malloc(sizeof(Connection));
+    pthread_t thread;
+    if (conn) {
+        conn->server = server;
+        conn->fd = fd;
+        if (pthread_create(&thread, NULL, server_connection, conn) == 0) {
+            pthread_detach(thread);
+            return;
+        }
+        free(conn);
+    }
+
+    if (!full) server_remove_connection(server, fd);
+    close(fd);
+}
+
+int server_run(LinearLayer* layer, const ServerConfig* config) {
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.layer = layer;
+    server.config = *config;
+    if (server.config.max_batch == 0) server.config.max_batch = 1;
+    atomic_store(&served_requests, 0);
+    atomic_store(&served_batches, 0);
+    atomic_store(&largest_batch, 0);
+    server.in_features = layer->weights->shape[1];
+    server.out_features = layer->weights->shape[0];
+
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&server.queue_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&server.idle_cond, NULL);
+
+    int listen_fd = server_listen(config->socket_path);
+    if (listen_fd < 0) return -1;
+
+    pthread_t batcher;
+    if (pthread_create(&batcher, NULL, server_batcher, &server) != 0) {
+        close(listen_fd);
+        return -1;
+    }
+
+    printf("Serving on %s (max batch %zu, max delay %ld us)\n",
+           config->socket_path, server.config.max_batch, server.config.max_delay_us);
+
+    atomic_store(&stop_requested, 0);
+    while (!atomic_load(&stop_requested)) {
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, SERVER_POLL_MS) > 0) server_accept(&server, listen_fd);
+    }
+
+    close(listen_fd);
+    unlink(config->socket_path);
+
+    // Unblock connection reads, let in-flight requests finish, then stop the batcher
+    pthread_mutex_lock(&server.lock);
+    for (size_t i = 0; i < server.connections; i++) {
+        shutdown(server.connection_fds[i], SHUT_RDWR);
+    }
+    while (server.connections > 0) {
+        pthread_cond_wait(&server.idle_cond, &server.lock);
+    }
+    server.batcher_exit = 1;
+    pthread_cond_signal(&server.queue_cond);
+    pthread_mutex_unlock(&server.lock);
+    pthread_join(batcher, NULL);
+
+    pthread_cond_destroy(&server.queue_cond);
+    pthread_cond_destroy(&server.idle_cond);
+    pthread_mutex_destroy(&server.lock);
+    return 0;
+}
+
+typedef struct {
+    const char* socket_path;
+    const LoadgenConfig* config;
+    size_t client;
+    double* latencies_us; // requests_per_client entries for this client
+    size_t errors;
+    int started;
+} LoadgenClient;
+
+static int loadgen_connect(const char* path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void* loadgen_client(void* arg) {
+    LoadgenClient* client = (LoadgenClient*)arg;
+    const LoadgenConfig* config = client->config;
+    size_t in_bytes = config->in_features * sizeof(double);
+    size_t out_bytes = config->out_features * sizeof(double);
+
+    size_t shape[] = {config->in_features};
+    MDArray* input = mdarray_create(1, shape, sizeof(double));
+    double* output = (double*)malloc(out_bytes);
+    RNG rng = rng_new(client->client);
+    int fd = loadgen_connect(client->socket_path);
+
+    for (size_t r = 0; r < config->requests_per_client; r++) {
+        client->latencies_us[r] = -1.0;
+        if (fd < 0 || !input || !output) {
+            client->errors++;
+            continue;
+        }
+
+        // MNIST-like pixel intensities
+        rng_uniform(&rng, input, 0.0, 255.0);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (write_full(fd, input->data, in_bytes) != 0 || read_full(fd, output, out_bytes) != 0) {
+            client->errors++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        client->latencies_us[r] = elapsed_us(&start, &end);
+    }
+
+    if (fd >= 0) close(fd);
+    free(output);
+    mdarray_free(input);
+    return NULL;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int server_loadgen(const char* socket_path, const LoadgenConfig* config, LoadgenResult* result) {
+    size_t total = config->clients * config->requests_per_client;
+    double* latencies = (double*)malloc((total ? total : 1) * sizeof(double));
+    LoadgenClient* clients = (LoadgenClient*)calloc(config->clients, sizeof(LoadgenClient));
+    pthread_t* threads = (pthread_t*)malloc(config->clients * sizeof(pthread_t));
+    if (!latencies || !clients || !threads) {
+        free(latencies);
+        free(clients);
+        free(threads);
+        return -1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t c = 0; c < config->clients; c++) {
+        clients[c].socket_path = socket_path;
+        clients[c].config = config;
+        clients[c].client = c;
+        clients[c].latencies_us = &latencies[c * config->requests_per_client];
+        clients[c].started = pthread_create(&threads[c], NULL, loadgen_client, &clients[c]) == 0;
+        if (!clients[c].started) {
+            clients[c].errors = config->requests_per_client;
+            for (size_t r = 0; r < config->requests_per_client; r++) clients[c].latencies_us[r] = -1.0;
+        }
+    }
+
+    memset(result, 0, sizeof(*result));
+    for (size_t c = 0; c < config->clients; c++) {
+        if (clients[c].started) pthread_join(threads[c], NULL);
+        result->errors += clients[c].errors;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Keep only the requests that completed
+    size_t n = 0;
+    for (size_t i = 0; i < total; i++) {
+        if (latencies[i] >= 0.0) latencies[n++] = latencies[i];
+    }
+    qsort(latencies, n, sizeof(double), compare_doubles);
+
+    result->requests = n;
+    result->seconds = elapsed_us(&start, &end) * 1e-6;
+    result->throughput = result->seconds > 0 ? (double)n / result->seconds : 0.0;
+    if (n > 0) {
+        result->p50_us = latencies[(size_t)(0.50 * (double)(n - 1))];
+        result->p99_us = latencies[(size_t)(0.99 * (double)(n - 1))];
+    }
+
+    free(latencies);
+    free(clients);
+    free(threads);
+    return result->errors == 0 ? 0 : -1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "linear.h"
+
+#define SERVER_MAX_BATCH 64
+#define SERVER_MAX_DELAY_US 2000
+
+// Wire protocol over a Unix domain stream socket, native byte order:
+// the client sends in_features doubles per request and reads back
+// out_features doubles. A connection may carry any number of requests.
+typedef struct {
+    const char* socket_path;
+    size_t max_batch;       // Largest batch handed to linear_forward
+    long max_delay_us;      // Longest a request waits for its batch to fill
+} ServerConfig;
+
+typedef struct {
+    size_t requests;        // Requests answered
+    size_t batches;         // linear_forward calls they were answered by
+    size_t largest_batch;
+} ServerStats;
+
+typedef struct {
+    size_t clients;              // Concurrent connections
+    size_t requests_per_client;  // Requests sent back to back on each connection
+    size_t in_features;
+    size_t out_features;
+} LoadgenConfig;
+
+typedef struct {
+    size_t requests;     // Requests that got a response
+    size_t errors;       // Requests that failed
+    double seconds;      // Wall time of the whole run
+    double throughput;   // Responses per second
+    double p50_us;       // Median latency in microseconds
+    double p99_us;       // 99th percentile latency in microseconds
+} LoadgenResult;
+
+ServerConfig server_default_config(const char* socket_path);
+
+// Serve layer until server_stop is called. Returns 0 on clean shutdown.
+int server_run(LinearLayer* layer, const ServerConfig* config);
+void server_stop(void);
+// Counts of the running server_run, or of the last one once it returned
+ServerStats server_stats(void);
+
+// Drive a running server and measure throughput and latency
+int server_loadgen(const char* socket_path, const LoadgenConfig* config, LoadgenResult* result);
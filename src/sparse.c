@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sparse.h"
+
+SparseMDArray* sparse_create(SparseFormat format, size_t rows, size_t cols, size_t nnz) {
+    SparseMDArray* arr = (SparseMDArray*)malloc(sizeof(SparseMDArray));
+    if (!arr) return NULL;
+
+    arr->format = format;
+    arr->shape[0] = rows;
+    arr->shape[1] = cols;
+    arr->nnz = nnz;
+
+    size_t major = format == SPARSE_CSR ? rows : cols;
+    arr->indptr = (size_t*)calloc(major + 1, sizeof(size_t));
+    // Allocate at least one element so an all-zero matrix is still valid
+    arr->indices = (size_t*)malloc((nnz ? nnz : 1) * sizeof(size_t));
+    arr->values = (double*)malloc((nnz ? nnz : 1) * sizeof(double));
+    if (!arr->indptr || !arr->indices || !arr->values) {
+        sparse_free(arr);
+        return NULL;
+    }
+
+    return arr;
+}
+
+void sparse_free(SparseMDArray* arr) {
+    if (arr) {
+        free(arr->indptr);
+        free(arr->indices);
+        free(arr->values);
+        free(arr);
+    }
+}
+
+static double dense_at(MDArray* arr, size_t i, size_t j) {
+    return ((double*)arr->data)[i * arr->strides[0] + j * arr->strides[1]];
+}
+
+// sparse_try_from_dense compresses a 2D array, giving up (returning NULL)
+// as soon as it sees more than max_density * total_size non-zero elements.
+SparseMDArray* sparse_try_from_dense(MDArray* arr, SparseFormat format, double max_density) {
+    if (arr->ndim != 2) {
+        printf("Sparse arrays are only implemented for 2D arrays\n");
+        return NULL;
+    }
+
+    size_t rows = arr->shape[0];
+    size_t cols = arr->shape[1];
+    size_t major = format == SPARSE_CSR ? rows : cols;
+    size_t max_nnz = (size_t)(max_density * (double)arr->total_size);
+
+    // First pass: count non-zero elements per row/column
+    size_t* counts = (size_t*)calloc(major + 1, sizeof(size_t));
+    if (!counts) return NULL;
+
+    size_t nnz = 0;
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            if (dense_at(arr, i, j) != 0.0) {
+                counts[format == SPARSE_CSR ? i : j]++;
+                nnz++;
+            }
+        }
+        if (nnz > max_nnz) {
+            free(counts);
+            return NULL;
+        }
+    }
+
+    SparseMDArray* out = sparse_create(format, rows, cols, nnz);
+    if (!out) {
+        free(counts);
+        return NULL;
+    }
+
+    for (size_t m = 0; m < major; m++) {
+        out->indptr[m + 1] = out->indptr[m] + counts[m];
+    }
+
+    // Second pass: scatter values, reusing counts as write cursors
+    memcpy(counts, out->indptr, major * sizeof(size_t));
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            double x = dense_at(arr, i, j);
+            if (x == 0.0) continue;
+
+            size_t m = format == SPARSE_CSR ? i : j;
+            size_t p = counts[m]++;
+            out->indices[p] = format == SPARSE_CSR ? j : i;
+            out->values[p] = x;
+        }
+    }
+
+    free(counts);
+    return out;
+}
+
+SparseMDArray* sparse_from_dense(MDArray* arr, SparseFormat format) {
+    return sparse_try_from_dense(arr, format, 1.0);
+}
+
+MDArray* sparse_to_dense(SparseMDArray* arr) {
+    MDArray* out = mdarray_create(2, arr->shape, sizeof(double));
+    if (!out) return NULL;
+    mdarray_zeros(out);
+
+    double* data = (double*)out->data;
+    size_t major = arr->format == SPARSE_CSR ? arr->shape[0] : arr->shape[1];
+    for (size_t m = 0; m < major; m++) {
+        for (size_t p = arr->indptr[m]; p < arr->indptr[m + 1]; p++) {
+            size_t i = arr->format == SPARSE_CSR ? m : arr->indices[p];
+            size_t j = arr->format == SPARSE_CSR ? arr->indices[p] : m;
+            data[i * arr->shape[1] + j] = arr->values[p];
+        }
+    }
+
+    return out;
+}
+
+double sparse_density(SparseMDArray* arr) {
+    size_t total = arr->shape[0] * arr->shape[1];
+    return total ? (double)arr->nnz / (double)total : 0.0;
+}
+
+double mdarray_density(MDArray* arr) {
+    if (arr->total_size == 0) return 0.0;
+
+    size_t nnz = 0;
+    for (size_t i = 0; i < arr->total_size; i++) {
+        if (((double*)arr->data)[i] != 0.0) nnz++;
+    }
+    return (double)nnz / (double)arr->total_size;
+}
+
+MDArray* sparse_dense_dot(MDArray* w, SparseMDArray* x) {
+    if (w->ndim != 2) {
+        printf("w ndim is different than 2\n");
+        return NULL;
+    }
+
+    if (w->shape[1] != x->shape[0]) {
+        printf("w.shape[1](%zu) different than x.shape[0](%zu)\n", w->shape[1], x->shape[0]);
+        return NULL;
+    }
+
+    size_t rows = w->shape[0];
+    size_t cols = x->shape[1];
+    size_t shape[] = {rows, cols};
+    MDArray* out = mdarray_create(2, shape, sizeof(double));
+    if (!out) return NULL;
+    mdarray_zeros(out);
+
+    double* wd = (double*)w->data;
+    double* od = (double*)out->data;
+    size_t ws0 = w->strides[0];
+    size_t ws1 = w->strides[1];
+
+    size_t major = x->format == SPARSE_CSR ? x->shape[0] : x->shape[1];
+    for (size_t m = 0; m < major; m++) {
+        for (size_t p = x->indptr[m]; p < x->indptr[m + 1]; p++) {
+            // x[k, n] = v contributes w[:, k] * v to out[:, n]
+            size_t k = x->format == SPARSE_CSR ? m : x->indices[p];
+            size_t n = x->format == SPARSE_CSR ? x->indices[p] : m;
+            double v = x->values[p];
+            for (size_t i = 0; i < rows; i++) {
+                od[i * cols + n] += wd[i * ws0 + k * ws1] * v;
+            }
+        }
+    }
+
+    return out;
+}
+
+MDArray* dense_sparse_t_dot(MDArray* g, SparseMDArray* x) {
+    if (g->ndim != 2) {
+        printf("g ndim is different than 2\n");
+        return NULL;
+    }
+
+    if (g->shape[1] != x->shape[1]) {
+        printf("g.shape[1](%zu) different than x.shape[1](%zu)\n", g->shape[1], x->shape[1]);
+        return NULL;
+    }
+
+    size_t rows = g->shape[0];
+    size_t cols = x->shape[0];
+    size_t shape[] = {rows, cols};
+    MDArray* out = mdarray_create(2, shape, sizeof(double));
+    if (!out) return NULL;
+    mdarray_zeros(out);
+
+    double* gd = (double*)g->data;
+    double* od = (double*)out->data;
+    size_t gs0 = g->strides[0];
+    size_t gs1 = g->strides[1];
+
+    size_t major = x->format == SPARSE_CSR ? x->shape[0] : x->shape[1];
+    for (size_t m = 0; m < major; m++) {
+        for (size_t p = x->indptr[m]; p < x->indptr[m + 1]; p++) {
+            // x[k, n] = v contributes g[:, n] * v to out[:, k]
+            size_t k = x->format == SPARSE_CSR ? m : x->indices[p];
+            size_t n = x->format == SPARSE_CSR ? x->indices[p] : m;
+            double v = x->values[p];
+            for (size_t i = 0; i < rows; i++) {
+                od[i * cols + k] += gd[i * gs0 + n * gs1] * v;
+            }
+        }
+    }
+
+    return out;
+}
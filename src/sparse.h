@@ -0,0 +1,40 @@
+#pragma once
+
+#include "mdarray.h"
+
+// Inputs whose fraction of non-zero elements is below this value are
+// multiplied with the sparse kernels; denser inputs use mdarray_dot.
+#define SPARSE_DENSITY_THRESHOLD 0.3
+
+typedef enum {
+    SPARSE_CSR, // Compressed rows: indptr walks rows, indices are columns
+    SPARSE_CSC  // Compressed columns: indptr walks columns, indices are rows
+} SparseFormat;
+
+// Compressed 2D matrix of doubles
+typedef struct {
+    SparseFormat format;
+    size_t shape[2];      // Dense shape (rows, cols)
+    size_t nnz;           // Number of stored elements
+    size_t* indptr;       // Start of each row (CSR) or column (CSC), length major + 1
+    size_t* indices;      // Column (CSR) or row (CSC) of each stored element
+    double* values;       // Stored elements
+} SparseMDArray;
+
+SparseMDArray* sparse_create(SparseFormat format, size_t rows, size_t cols, size_t nnz);
+void sparse_free(SparseMDArray* arr);
+SparseMDArray* sparse_from_dense(MDArray* arr, SparseFormat format);
+SparseMDArray* sparse_try_from_dense(MDArray* arr, SparseFormat format, double max_density);
+MDArray* sparse_to_dense(SparseMDArray* arr);
+double sparse_density(SparseMDArray* arr);
+double mdarray_density(MDArray* arr);
+
+// w       10x784 dense
+// x       784xN  sparse
+// RETURNS 10xN   dense (w * x)
+MDArray* sparse_dense_dot(MDArray* w, SparseMDArray* x);
+
+// g       10xN   dense
+// x       784xN  sparse
+// RETURNS 10x784 dense (g * x^T)
+MDArray* dense_sparse_t_dot(MDArray* g, SparseMDArray* x);
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "loss.h"
+#include "train.h"
+
+Sequential* sequential_create(Layer** layers, size_t n_layers) {
+    Sequential* model = malloc(sizeof(Sequential));
+    if (!model) return NULL;
+
+    model->layers = layers;
+    model->n_layers = n_layers;
+    model->recompute = calloc(n_layers ? n_layers : 1, sizeof(int));
+    if (!model->recompute) {
+        free(model);
+        return NULL;
+    }
+
+    return model;
+}
+
+void sequential_free(Sequential* model) {
+    if (model) {
+        free(model->recompute);
+        free(model);
+    }
+}
+
+void sequential_set_recompute(Sequential* model, size_t layer, int recompute) {
+    if (layer < model->n_layers) model->recompute[layer] = recompute;
+}
+
+void sequential_zero_grad(Sequential* model) {
+    for (size_t l = 0; l < model->n_layers; l++) {
+        Layer* layer = model->layers[l];
+        if (layer->zero_grad) layer->zero_grad(layer);
+    }
+}
+
+TrainConfig train_default_config(void) {
+    TrainConfig config = {0, 0, 1};
+    return config;
+}
+
+static int sequential_starts_run(Sequential* model, size_t l) {
+    return model->recompute[l] && (l == 0 || !model->recompute[l - 1]);
+}
+
+// Forward of one micro-batch. saved[l] receives the input of every layer
+// starting a recomputed run. Returns the output of the last layer.
+static MDArray* sequential_forward(Sequential* model, MDArray* input, MDArray** saved) {
+    MDArray* x = mdarray_view(input);
+
+    for (size_t l = 0; l < model->n_layers && x; l++) {
+        Layer* layer = model->layers[l];
+        if (sequential_starts_run(model, l)) saved[l] = mdarray_view(x);
+
+        // Layers keep their own reference to what backward needs
+        MDArray* y = layer->forward(layer, x);
+        mdarray_free(x);
+        if (model->recompute[l] && layer->release) layer->release(layer);
+        x = y;
+    }
+
+    return x;
+}
+
+// Runs forward again over the recomputed run ending at layer end, so its
+// layers hold their saved activations for backward
+static int sequential_replay(Sequential* model, size_t end, MDArray** saved) {
+    size_t start = end;
+    while (start > 0 && model->recompute[start - 1]) start--;
+
+    MDArray* x = saved[start];
+    saved[start] = NULL;
+    for (size_t l = start; l <= end && x; l++) {
+        Layer* layer = model->layers[l];
+        MDArray* y = layer->forward(layer, x);
+        mdarray_free(x);
+        x = y;
+    }
+
+    int status = x ? 0 : -1;
+    mdarray_free(x);
+    return status;
+}
+
+static int sequential_backward(Sequential* model, MDArray* grad, MDArray** saved) {
+    for (size_t l = model->n_layers; l > 0 && grad; l--) {
+        size_t i = l - 1;
+        Layer* layer = model->layers[i];
+        if (model->recompute[i] && (l == model->n_layers || !model->recompute[l]) &&
+            sequential_replay(model, i, saved) != 0) {
+            mdarray_free(grad);
+            return -1;
+        }
+
+        MDArray* next = layer->backward(layer, grad);
+        mdarray_free(grad);
+        grad = next;
+
+        // Nothing reads this layer's activations again until the next forward
+        if (layer->release) layer->release(layer);
+    }
+
+    int status = grad ? 0 : -1;
+    mdarray_free(grad);
+    return status;
+}
+
+// Forward and backward of samples [begin, end), the loss gradient scaled
+// by scale. Returns the micro-batch loss, or -1.0 on failure.
+static double train_micro_batch(Sequential* model, MDArray* inputs, MDArray* targets, size_t axis,
+                                size_t begin, size_t end, double scale) {
+    // A packed micro-batch lets the specialized kernels run
+    MDArray* slice = mdarray_slice(inputs, axis, begin, end);
+    MDArray* x = slice ? mdarray_contiguous(slice) : NULL;
+    MDArray* t = mdarray_slice(targets, 1, begin, end);
+    MDArray** saved = calloc(model->n_layers ? model->n_layers : 1, sizeof(MDArray*));
+    mdarray_free(slice);
+
+    double loss = -1.0;
+    MDArray* out = x && t && saved ? sequential_forward(model, x, saved) : NULL;
+    MDArray* grad = out ? mse_loss_gradient(out, t) : NULL;
+    if (grad) {
+        loss = mse_loss(out, t);
+        double* g = (double*)grad->data;
+        for (size_t i = 0; i < grad->total_size; i++) g[i] *= scale;
+    }
+    mdarray_free(out);
+
+    if (grad && sequential_backward(model, grad, saved) != 0) loss = -1.0;
+
+    if (saved) {
+        for (size_t l = 0; l < model->n_layers; l++) mdarray_free(saved[l]);
+    }
+    free(saved);
+    mdarray_free(x);
+    mdarray_free(t);
+    return loss;
+}
+
+// Allocator bytes a step over the first n samples needs on top of what was live
+static size_t train_probe(Sequential* model, MDArray* inputs, MDArray* targets, size_t axis, size_t n) {
+    size_t live = allocator_stats().live_bytes;
+    allocator_reset_peak();
+    train_micro_batch(model, inputs, targets, axis, 0, n, 1.0);
+
+    size_t peak = allocator_stats().peak_bytes;
+    return peak > live ? peak - live : 0;
+}
+
+// config->micro_batch if set, otherwise the largest micro-batch whose step
+// fits memory_budget. The probes accumulate into the gradients, which must
+// already exist so both probes measure the same step, and be zeroed again
+// afterwards.
+static size_t train_micro_batch_size(Sequential* model, MDArray* inputs, MDArray* targets,
+                                     const TrainConfig* config) {
+    size_t batch = inputs->shape[config->input_batch_axis];
+    if (config->micro_batch) return config->micro_batch < batch ? config->micro_batch : batch;
+    if (!config->memory_budget || batch < 2) return batch;
+
+    // The difference of two probe sizes separates per-sample activation
+    // memory from what every step needs regardless (gradients, GEMM packing)
+    size_t small = batch / 2 < TRAIN_PROBE_SAMPLES ? batch / 2 : TRAIN_PROBE_SAMPLES;
+    size_t small_bytes = train_probe(model, inputs, targets, config->input_batch_axis, small);
+    size_t large_bytes = train_probe(model, inputs, targets, config->input_batch_axis, 2 * small);
+
+    size_t per_sample = large_bytes > small_bytes ? (large_bytes - small_bytes + small - 1) / small : 1;
+    size_t fixed = small_bytes > per_sample * small ? small_bytes - per_sample * small : 0;
+    if (fixed + per_sample > config->memory_budget) {
+        printf("Memory budget of %zu bytes is below one sample (%zu + %zu bytes), using micro-batches of 1\n",
+               config->memory_budget, fixed, per_sample);
+        return 1;
+    }
+
+    size_t micro_batch = (config->memory_budget - fixed) / per_sample;
+    return micro_batch < batch ? micro_batch : batch;
+}
+
+double train_batch_gradients(Sequential* model, MDArray* inputs, MDArray* targets, const TrainConfig* config) {
+    TrainConfig defaults = train_default_config();
+    if (!config) config = &defaults;
+
+    size_t axis = config->input_batch_axis;
+    if (axis >= inputs->ndim || targets->ndim != 2 || targets->shape[1] != inputs->shape[axis]) {
+        printf("Inputs and targets [outputs, N] must hold the same number of samples\n");
+        return -1.0;
+    }
+
+    int* accumulate = calloc(model->n_layers ? model->n_layers : 1, sizeof(int));
+    if (!accumulate) return -1.0;
+
+    // Accumulate for the duration of the batch, probes included, so they
+    // measure the same steps the batch runs
+    for (size_t l = 0; l < model->n_layers; l++) {
+        Layer* layer = model->layers[l];
+        if (layer->set_accumulate) accumulate[l] = layer->set_accumulate(layer, 1);
+    }
+
+    // Zeroing allocates missing gradients, so they count as live rather
+    // than as probe memory
+    size_t batch = inputs->shape[axis];
+    sequential_zero_grad(model);
+    size_t micro_batch = train_micro_batch_size(model, inputs, targets, config);
+    sequential_zero_grad(model);
+
+    // Each micro-batch's loss gradient is scaled by its share of the batch,
+    // so the accumulated gradients are those of the mean over all samples
+    double loss = 0.0;
+    for (size_t begin = 0; begin < batch && loss >= 0.0; begin += micro_batch) {
+        size_t end = batch - begin < micro_batch ? batch : begin + micro_batch;
+        double share = (double)(end - begin) / (double)batch;
+        double micro_loss = train_micro_batch(model, inputs, targets, axis, begin, end, share);
+        loss = micro_loss < 0.0 ? -1.0 : loss + share * micro_loss;
+    }
+
+    for (size_t l = 0; l < model->n_layers; l++) {
+        Layer* layer = model->layers[l];
+        if (layer->set_accumulate) layer->set_accumulate(layer, accumulate[l]);
+    }
+    free(accumulate);
+
+    return loss;
+}
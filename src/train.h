@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "layer.h"
+
+// Samples in the two probe steps that measure a model's memory per sample
+#define TRAIN_PROBE_SAMPLES 8
+
+typedef struct {
+    size_t micro_batch;         // Samples per micro-batch, 0 to derive from memory_budget
+    size_t memory_budget;       // Allocator bytes one micro-batch step may use, 0 for no limit
+    size_t input_batch_axis;    // Axis of the inputs indexing samples: 1 for [features, N], 0 for NHWC
+} TrainConfig;
+
+// Layers applied in order. The last one produces [outputs, N], which is
+// trained against targets [outputs, N] with the MSE loss.
+typedef struct {
+    Layer** layers;             // Not owned
+    size_t n_layers;
+    int* recompute;             // Per layer, see sequential_set_recompute
+} Sequential;
+
+Sequential* sequential_create(Layer** layers, size_t n_layers);
+void sequential_free(Sequential* model);
+// A recomputed layer drops what its forward saved right away. Each run of
+// consecutive recomputed layers keeps only its input and replays its
+// forward once backward reaches it, trading compute for activation memory.
+void sequential_set_recompute(Sequential* model, size_t layer, int recompute);
+void sequential_zero_grad(Sequential* model);
+
+TrainConfig train_default_config(void);
+
+// Zeros the layers' gradients and accumulates those of the mean loss over
+// the whole batch in place, one micro-batch at a time. Only one
+// micro-batch of activations is alive at once. Micro-batches hold
+// config->micro_batch samples if set, otherwise as many as fit a step in
+// memory_budget, measured by two probe steps on the first samples. The
+// layers' accumulate settings are restored afterwards. Returns the loss,
+// or -1.0 on failure.
+double train_batch_gradients(Sequential* model, MDArray* inputs, MDArray* targets, const TrainConfig* config);
@@ -0,0 +1,89 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "allocator.h"
+#include "mdarray.h"
+
+static int is_aligned(void* ptr) {
+    return ((uintptr_t)ptr % ALLOCATOR_ALIGNMENT) == 0;
+}
+
+void test_allocator_alignment(void) {
+    size_t sizes[] = {1, 3, 7, 100, 1000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t shape[] = {sizes[i]};
+        MDArray* arr = mdarray_create(1, shape, sizeof(double));
+        TEST_ASSERT_NOT_NULL(arr);
+        TEST_ASSERT_TRUE(is_aligned(arr->data));
+        mdarray_free(arr);
+    }
+}
+
+void test_allocator_huge_pages(void) {
+    // Lower the threshold so a small buffer takes the mmap path
+    AllocatorConfig config = allocator_default_config();
+    config.huge_page_threshold = 4096;
+    config.numa_first_touch = 1;
+    allocator_configure(&config);
+
+    size_t before = allocator_stats().huge_allocations;
+    size_t shape[] = {1024, 8};
+    MDArray* arr = mdarray_create(2, shape, sizeof(double));
+    TEST_ASSERT_NOT_NULL(arr);
+    TEST_ASSERT_TRUE(is_aligned(arr->data));
+    TEST_ASSERT_EQUAL(before + 1, allocator_stats().huge_allocations);
+
+    // The whole buffer is writable
+    mdarray_ones(arr);
+    TEST_ASSERT_EQUAL(1, ((double*)arr->data)[arr->total_size - 1]);
+
+    mdarray_free(arr);
+    allocator_configure(NULL);
+}
+
+void test_allocator_stats(void) {
+    AllocatorStats before = allocator_stats();
+    allocator_reset_peak();
+
+    size_t shape[] = {100};
+    MDArray* a = mdarray_create(1, shape, sizeof(double));
+    MDArray* b = mdarray_create(1, shape, sizeof(double));
+    TEST_ASSERT_EQUAL(before.live_bytes + 1600, allocator_stats().live_bytes);
+
+    mdarray_free(a);
+    TEST_ASSERT_EQUAL(before.live_bytes + 800, allocator_stats().live_bytes);
+    TEST_ASSERT_EQUAL(before.live_bytes + 1600, allocator_stats().peak_bytes);
+
+    mdarray_free(b);
+    TEST_ASSERT_EQUAL(before.live_bytes, allocator_stats().live_bytes);
+}
+
+static size_t custom_calls;
+
+static void* counting_alloc(void* ctx, size_t bytes) {
+    (void)ctx;
+    custom_calls++;
+    return aligned_alloc(ALLOCATOR_ALIGNMENT, (bytes + ALLOCATOR_ALIGNMENT - 1) / ALLOCATOR_ALIGNMENT * ALLOCATOR_ALIGNMENT);
+}
+
+static void counting_free(void* ctx, void* ptr, size_t bytes) {
+    (void)ctx;
+    (void)bytes;
+    custom_calls++;
+    free(ptr);
+}
+
+void test_allocator_custom(void) {
+    Allocator allocator = {counting_alloc, counting_free, NULL};
+    allocator_set(&allocator);
+    custom_calls = 0;
+
+    size_t shape[] = {4, 4};
+    MDArray* arr = mdarray_create(2, shape, sizeof(double));
+    mdarray_free(arr);
+    allocator_set(NULL);
+
+    TEST_ASSERT_EQUAL(2, custom_calls);
+}
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unity.h"
+#include "checkpoint.h"
+#include "linear.h"
+#include "rng.h"
+
+static void checkpoint_test_path(char* path, size_t size, const char* name) {
+    snprintf(path, size, "/tmp/nnc_%s_%d.ckpt", name, (int)getpid());
+}
+
+void test_checkpoint_roundtrip_is_zero_copy(void) {
+    char path[64];
+    checkpoint_test_path(path, sizeof(path), "roundtrip");
+
+    size_t a_shape[] = {3, 5};
+    size_t b_shape[] = {7};
+    MDArray* a = mdarray_create(2, a_shape, sizeof(double));
+    MDArray* b = mdarray_create(1, b_shape, sizeof(double));
+    RNG rng = rng_new(3);
+    rng_uniform(&rng, a, -1.0, 1.0);
+    rng_uniform(&rng, b, -1.0, 1.0);
+
+    // A transposed view is packed on save
+    MDArray* at = mdarray_transpose_view(a);
+    CheckpointTensor tensors[] = {{"a", a}, {"b", b}, {"at", at}};
+    TEST_ASSERT_EQUAL(0, checkpoint_save(path, tensors, 3));
+
+    Checkpoint* ckpt = checkpoint_open(path, 0);
+    TEST_ASSERT_NOT_NULL(ckpt);
+    MDArray* la = checkpoint_get(ckpt, "a");
+    MDArray* lat = checkpoint_get(ckpt, "at");
+    TEST_ASSERT_NULL(checkpoint_get(ckpt, "missing"));
+    TEST_ASSERT_NOT_NULL(la);
+    TEST_ASSERT_NOT_NULL(lat);
+
+    // Views point into the mapping at aligned offsets
+    TEST_ASSERT_TRUE(la->buffer == ckpt->mapping);
+    TEST_ASSERT_TRUE(la->buffer->readonly);
+    TEST_ASSERT_EQUAL(0, (size_t)la->data % CHECKPOINT_ALIGNMENT);
+    checkpoint_close(ckpt);
+
+    // and outlive the handle
+    TEST_ASSERT_EQUAL(2, la->ndim);
+    TEST_ASSERT_EQUAL(5, lat->shape[0]);
+    TEST_ASSERT_EQUAL(3, lat->shape[1]);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 5; j++) {
+            TEST_ASSERT_EQUAL_DOUBLE(((double*)a->data)[i * 5 + j], ((double*)la->data)[i * 5 + j]);
+            TEST_ASSERT_EQUAL_DOUBLE(((double*)a->data)[i * 5 + j], ((double*)lat->data)[j * 3 + i]);
+        }
+    }
+
+    mdarray_free(la);
+    mdarray_free(lat);
+    mdarray_free(at);
+    mdarray_free(a);
+    mdarray_free(b);
+    remove(path);
+}
+
+void test_checkpoint_rejects_corruption(void) {
+    char path[64];
+    checkpoint_test_path(path, sizeof(path), "corrupt");
+
+    size_t shape[] = {16};
+    MDArray* a = mdarray_create(1, shape, sizeof(double));
+    mdarray_ones(a);
+    CheckpointTensor tensors[] = {{"a", a}};
+    TEST_ASSERT_EQUAL(0, checkpoint_save(path, tensors, 1));
+
+    FILE* file = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    unsigned char bytes[1024];
+    size_t size = fread(bytes, 1, sizeof(bytes), file);
+    fclose(file);
+    TEST_ASSERT_TRUE(size > sizeof(CheckpointHeader) && size < sizeof(bytes));
+
+    // Flipped payload byte: caught by the checksum unless it is skipped
+    bytes[size - 1] ^= 0xff;
+    file = fopen(path, "wb");
+    fwrite(bytes, 1, size, file);
+    fclose(file);
+    TEST_ASSERT_NULL(checkpoint_open(path, 0));
+    Checkpoint* trusted = checkpoint_open(path, CHECKPOINT_SKIP_CHECKSUM);
+    TEST_ASSERT_NOT_NULL(trusted);
+    checkpoint_close(trusted);
+
+    // Shape whose element count wraps to 0, paired with an empty payload
+    bytes[size - 1] ^= 0xff;
+    CheckpointEntry entry;
+    memcpy(&entry, bytes + sizeof(CheckpointHeader), sizeof(entry));
+    CheckpointEntry wrapped = entry;
+    wrapped.ndim = 2;
+    wrapped.shape[0] = 1ULL << 61;
+    wrapped.shape[1] = 8;
+    wrapped.nbytes = 0;
+    memcpy(bytes + sizeof(CheckpointHeader), &wrapped, sizeof(wrapped));
+    file = fopen(path, "wb");
+    fwrite(bytes, 1, size, file);
+    fclose(file);
+    TEST_ASSERT_NULL(checkpoint_open(path, CHECKPOINT_SKIP_CHECKSUM));
+    memcpy(bytes + sizeof(CheckpointHeader), &entry, sizeof(entry));
+
+    // Truncated file
+    file = fopen(path, "wb");
+    fwrite(bytes, 1, size - 8, file);
+    fclose(file);
+    TEST_ASSERT_NULL(checkpoint_open(path, 0));
+
+    // Bad magic
+    bytes[0] = 'X';
+    file = fopen(path, "wb");
+    fwrite(bytes, 1, size, file);
+    fclose(file);
+    TEST_ASSERT_NULL(checkpoint_open(path, 0));
+
+    remove(path);
+    TEST_ASSERT_NULL(checkpoint_open(path, 0));
+    mdarray_free(a);
+}
+
+void test_checkpoint_copies_on_write(void) {
+    char path[64];
+    checkpoint_test_path(path, sizeof(path), "cow");
+
+    size_t shape[] = {4, 4};
+    MDArray* a = mdarray_create(2, shape, sizeof(double));
+    mdarray_ones(a);
+    CheckpointTensor tensors[] = {{"a", a}};
+    TEST_ASSERT_EQUAL(0, checkpoint_save(path, tensors, 1));
+
+    Checkpoint* ckpt = checkpoint_open(path, 0);
+    TEST_ASSERT_NOT_NULL(ckpt);
+    MDArray* first = checkpoint_get(ckpt, "a");
+    MDArray* second = checkpoint_get(ckpt, "a");
+    MDBuffer* mapping = ckpt->mapping;
+    checkpoint_close(ckpt);
+
+    // Writing detaches first from the mapping, second still reads the file
+    TEST_ASSERT_EQUAL(0, mdarray_make_writable(first));
+    TEST_ASSERT_TRUE(first->buffer != mapping);
+    TEST_ASSERT_FALSE(first->buffer->readonly);
+    ((double*)first->data)[5] = 7.0;
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, ((double*)second->data)[5]);
+
+    mdarray_free(first);
+    mdarray_free(second);
+    mdarray_free(a);
+    remove(path);
+}
+
+void test_linear_checkpoint_roundtrip(void) {
+    char path[64];
+    checkpoint_test_path(path, sizeof(path), "linear");
+
+    LinearLayer* layer = linear_create(12, 3);
+    RNG rng = rng_new(5);
+    linear_init_xavier(layer, &rng);
+    rng_uniform(&rng, layer->biases, -1.0, 1.0);
+    TEST_ASSERT_EQUAL(0, linear_save(layer, path));
+
+    LinearLayer* loaded = linear_load(path);
+    TEST_ASSERT_NOT_NULL(loaded);
+    TEST_ASSERT_TRUE(loaded->weights->buffer->readonly);
+
+    size_t x_shape[] = {12, 6};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    rng_uniform(&rng, x, -1.0, 1.0);
+    MDArray* expected = linear_forward(layer, x);
+    MDArray* actual = linear_forward(loaded, x);
+    TEST_ASSERT_NOT_NULL(actual);
+    for (size_t i = 0; i < expected->total_size; i++) {
+        TEST_ASSERT_EQUAL_DOUBLE(((double*)expected->data)[i], ((double*)actual->data)[i]);
+    }
+
+    // A file holding other tensors is not a linear layer
+    CheckpointTensor tensors[] = {{"linear.weights", x}};
+    TEST_ASSERT_EQUAL(0, checkpoint_save(path, tensors, 1));
+    TEST_ASSERT_NULL(linear_load(path));
+
+    mdarray_free(expected);
+    mdarray_free(actual);
+    mdarray_free(x);
+    linear_free(loaded);
+    linear_free(layer);
+    remove(path);
+}
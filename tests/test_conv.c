@@ -0,0 +1,352 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "allocator.h"
+#include "conv.h"
+#include "layer.h"
+#include "linear.h"
+#include "loss.h"
+#include "pool.h"
+#include "rng.h"
+
+#define FLOAT_EPSILON 0.0001f
+
+static MDArray* create_random4(size_t n, size_t h, size_t w, size_t c, uint64_t seed) {
+    size_t shape[] = {n, h, w, c};
+    MDArray* arr = mdarray_create(4, shape, sizeof(double));
+    RNG rng = rng_new(seed);
+    rng_uniform(&rng, arr, -1.0, 1.0);
+    return arr;
+}
+
+static int arrays_close(MDArray* a, MDArray* b) {
+    if (!a || !b || a->total_size != b->total_size) return 0;
+    for (size_t i = 0; i < a->total_size; i++) {
+        if (fabs(((double*)a->data)[i] - ((double*)b->data)[i]) > FLOAT_EPSILON) return 0;
+    }
+    return 1;
+}
+
+// Straightforward NHWC convolution used as the reference
+static double reference_conv(Conv2DLayer* layer, MDArray* x, size_t n, size_t oh, size_t ow, size_t co) {
+    size_t k = layer->weights->shape[0];
+    size_t c_in = layer->weights->shape[2];
+    size_t c_out = layer->weights->shape[3];
+    double sum = ((double*)layer->biases->data)[co];
+
+    for (size_t kh = 0; kh < k; kh++) {
+        for (size_t kw = 0; kw < k; kw++) {
+            long ih = (long)(oh * layer->stride + kh) - (long)layer->padding;
+            long iw = (long)(ow * layer->stride + kw) - (long)layer->padding;
+            if (ih < 0 || iw < 0 || ih >= (long)x->shape[1] || iw >= (long)x->shape[2]) continue;
+            for (size_t ci = 0; ci < c_in; ci++) {
+                size_t xi[] = {n, (size_t)ih, (size_t)iw, ci};
+                double w = ((double*)layer->weights->data)[((kh * k + kw) * c_in + ci) * c_out + co];
+                sum += *(double*)mdarray_get_element(x, xi) * w;
+            }
+        }
+    }
+    return sum;
+}
+
+void test_conv2d_forward_algorithms_agree(void) {
+    size_t strides[] = {1, 2};
+    for (size_t s = 0; s < 2; s++) {
+        MDArray* x = create_random4(3, 7, 6, 2, 1);
+        Conv2DLayer* layer = conv2d_create(2, 5, 3, strides[s], 1);
+        RNG rng = rng_new(2);
+        rng_uniform(&rng, layer->weights, -1.0, 1.0);
+        rng_uniform(&rng, layer->biases, -1.0, 1.0);
+
+        layer->algorithm = CONV_ALGO_DIRECT;
+        MDArray* direct = conv2d_forward(layer, x);
+        layer->algorithm = CONV_ALGO_IM2COL;
+        MDArray* im2col = conv2d_forward(layer, x);
+
+        TEST_ASSERT_NOT_NULL(direct);
+        TEST_ASSERT_TRUE(arrays_close(direct, im2col));
+
+        for (size_t n = 0; n < direct->shape[0]; n++) {
+            for (size_t oh = 0; oh < direct->shape[1]; oh++) {
+                for (size_t ow = 0; ow < direct->shape[2]; ow++) {
+                    for (size_t co = 0; co < 5; co++) {
+                        size_t idx[] = {n, oh, ow, co};
+                        double expected = reference_conv(layer, x, n, oh, ow, co);
+                        TEST_ASSERT_TRUE(fabs(expected - *(double*)mdarray_get_element(direct, idx)) < FLOAT_EPSILON);
+                    }
+                }
+            }
+        }
+
+        mdarray_free(direct);
+        mdarray_free(im2col);
+        conv2d_free(layer);
+        mdarray_free(x);
+    }
+}
+
+void test_conv_pool_backward_check_grad_output(void) {
+    MDArray* x = create_random4(2, 6, 6, 3, 10);
+    Conv2DLayer* conv = conv2d_create(3, 4, 3, 1, 1);
+    Pool2DLayer* pool = pool2d_create(POOL_MAX, 2, 2);
+    RNG rng = rng_new(11);
+    rng_uniform(&rng, conv->weights, -1.0, 1.0);
+
+    MDArray* conv_out = conv2d_forward(conv, x);
+    MDArray* pool_out = pool2d_forward(pool, conv_out);
+
+    // The same gradients as the first channels of wider arrays, strided
+    MDArray* wide_conv = create_random4(2, 6, 6, 6, 12);
+    MDArray* wide_pool = create_random4(2, 3, 3, 6, 13);
+    MDArray* conv_g = mdarray_slice(wide_conv, 3, 0, 4);
+    MDArray* pool_g = mdarray_slice(wide_pool, 3, 0, 4);
+    MDArray* conv_packed = mdarray_contiguous(conv_g);
+    MDArray* pool_packed = mdarray_contiguous(pool_g);
+
+    MDArray* conv_dx = conv2d_backward(conv, conv_packed);
+    MDArray* conv_dx_strided = conv2d_backward(conv, conv_g);
+    TEST_ASSERT_TRUE(arrays_close(conv_dx, conv_dx_strided));
+    MDArray* pool_dx = pool2d_backward(pool, pool_packed);
+    MDArray* pool_dx_strided = pool2d_backward(pool, pool_g);
+    TEST_ASSERT_TRUE(arrays_close(pool_dx, pool_dx_strided));
+
+    // Gradients shaped unlike the last output are refused
+    TEST_ASSERT_NULL(conv2d_backward(conv, pool_packed));
+    TEST_ASSERT_NULL(conv2d_backward(conv, wide_conv));
+    TEST_ASSERT_NULL(pool2d_backward(pool, conv_packed));
+    TEST_ASSERT_NULL(pool2d_backward(pool, wide_pool));
+
+    mdarray_free(pool_dx_strided);
+    mdarray_free(pool_dx);
+    mdarray_free(conv_dx_strided);
+    mdarray_free(conv_dx);
+    mdarray_free(pool_packed);
+    mdarray_free(conv_packed);
+    mdarray_free(pool_g);
+    mdarray_free(conv_g);
+    mdarray_free(wide_pool);
+    mdarray_free(wide_conv);
+    mdarray_free(pool_out);
+    mdarray_free(conv_out);
+    pool2d_free(pool);
+    conv2d_free(conv);
+    mdarray_free(x);
+}
+
+// Loss = sum(out * g), so dL/dout = g and dL/dw can be checked numerically
+static double weighted_output(Conv2DLayer* layer, MDArray* x, MDArray* g) {
+    MDArray* out = conv2d_forward(layer, x);
+    double sum = 0.0;
+    for (size_t i = 0; i < out->total_size; i++) {
+        sum += ((double*)out->data)[i] * ((double*)g->data)[i];
+    }
+    mdarray_free(out);
+    return sum;
+}
+
+void test_conv2d_backward_gradients(void) {
+    MDArray* x = create_random4(2, 5, 5, 3, 3);
+    Conv2DLayer* layer = conv2d_create(3, 4, 3, 1, 1);
+    RNG rng = rng_new(4);
+    rng_uniform(&rng, layer->weights, -1.0, 1.0);
+
+    MDArray* out = conv2d_forward(layer, x);
+    MDArray* g = create_random4(out->shape[0], out->shape[1], out->shape[2], out->shape[3], 5);
+
+    layer->algorithm = CONV_ALGO_DIRECT;
+    MDArray* dx_direct = conv2d_backward(layer, g);
+    MDArray* dw_direct = layer->grad_weights;
+    layer->grad_weights = NULL;
+
+    layer->algorithm = CONV_ALGO_IM2COL;
+    MDArray* dx_im2col = conv2d_backward(layer, g);
+    TEST_ASSERT_TRUE(arrays_close(dx_direct, dx_im2col));
+    TEST_ASSERT_TRUE(arrays_close(dw_direct, layer->grad_weights));
+
+    // Central differences on a few weights and inputs
+    double h = 1e-5;
+    size_t probes[] = {0, 17, 50, 107};
+    for (size_t p = 0; p < 4; p++) {
+        double* w = &((double*)layer->weights->data)[probes[p]];
+        double saved = *w;
+        *w = saved + h;
+        double plus = weighted_output(layer, x, g);
+        *w = saved - h;
+        double minus = weighted_output(layer, x, g);
+        *w = saved;
+        TEST_ASSERT_TRUE(fabs((plus - minus) / (2 * h) - ((double*)dw_direct->data)[probes[p]]) < 1e-4);
+
+        double* xi = &((double*)x->data)[probes[p]];
+        saved = *xi;
+        *xi = saved + h;
+        plus = weighted_output(layer, x, g);
+        *xi = saved - h;
+        minus = weighted_output(layer, x, g);
+        *xi = saved;
+        TEST_ASSERT_TRUE(fabs((plus - minus) / (2 * h) - ((double*)dx_direct->data)[probes[p]]) < 1e-4);
+    }
+
+    mdarray_free(dx_direct);
+    mdarray_free(dw_direct);
+    mdarray_free(dx_im2col);
+    mdarray_free(g);
+    mdarray_free(out);
+    conv2d_free(layer);
+    mdarray_free(x);
+}
+
+// Refuses buffers above *limit bytes
+static void* limited_alloc(void* ctx, size_t bytes) {
+    void* ptr = NULL;
+    if (bytes > *(size_t*)ctx || posix_memalign(&ptr, ALLOCATOR_ALIGNMENT, bytes) != 0) return NULL;
+    return ptr;
+}
+
+static void limited_free(void* ctx, void* ptr, size_t bytes) {
+    (void)ctx;
+    (void)bytes;
+    free(ptr);
+}
+
+void test_conv2d_im2col_without_scratch(void) {
+    // The im2col buffer and the weight partials are larger than any
+    // activation, so a limit between them leaves only the activations
+    size_t limit = (size_t)-1;
+    Allocator allocator = {limited_alloc, limited_free, &limit};
+    allocator_set(&allocator);
+
+    MDArray* x = create_random4(2, 3, 3, 16, 6);
+    Conv2DLayer* layer = conv2d_create(16, 16, 3, 1, 1);
+    RNG rng = rng_new(7);
+    rng_uniform(&rng, layer->weights, -1.0, 1.0);
+    rng_uniform(&rng, layer->biases, -1.0, 1.0);
+    layer->algorithm = CONV_ALGO_IM2COL;
+
+    MDArray* out = conv2d_forward(layer, x);
+    MDArray* g = create_random4(2, 3, 3, 16, 8);
+    MDArray* dx = conv2d_backward(layer, g);
+    MDArray* dw = layer->grad_weights;
+    layer->grad_weights = NULL;
+    mdarray_free(conv2d_backward(layer, g));
+    conv2d_zero_grad(layer);
+    layer->accumulate = 1;
+
+    limit = 4096;
+    MDArray* out_limited = conv2d_forward(layer, x);
+    MDArray* dx_limited = conv2d_backward(layer, g);
+    TEST_ASSERT_TRUE(arrays_close(out, out_limited));
+    TEST_ASSERT_TRUE(arrays_close(dx, dx_limited));
+    TEST_ASSERT_TRUE(arrays_close(dw, layer->grad_weights));
+    limit = (size_t)-1;
+
+    mdarray_free(dx_limited);
+    mdarray_free(out_limited);
+    mdarray_free(dx);
+    mdarray_free(dw);
+    mdarray_free(g);
+    mdarray_free(out);
+    conv2d_free(layer);
+    mdarray_free(x);
+    allocator_set(NULL);
+}
+
+void test_pool2d_max_and_avg(void) {
+    // One 4x4 single channel image
+    size_t shape[] = {1, 4, 4, 1};
+    MDArray* x = mdarray_create(4, shape, sizeof(double));
+    for (size_t i = 0; i < 16; i++) ((double*)x->data)[i] = (double)i;
+
+    Pool2DLayer* max_pool = pool2d_create(POOL_MAX, 2, 2);
+    MDArray* max_out = pool2d_forward(max_pool, x);
+    double expected_max[] = {5, 7, 13, 15};
+    for (size_t i = 0; i < 4; i++) TEST_ASSERT_EQUAL(expected_max[i], ((double*)max_out->data)[i]);
+
+    // Gradient flows only to each window's maximum
+    MDArray* dx = pool2d_backward(max_pool, max_out);
+    for (size_t i = 0; i < 16; i++) {
+        double expected = (i == 5 || i == 7 || i == 13 || i == 15) ? (double)i : 0.0;
+        TEST_ASSERT_EQUAL(expected, ((double*)dx->data)[i]);
+    }
+    mdarray_free(dx);
+
+    Pool2DLayer* avg_pool = pool2d_create(POOL_AVG, 2, 2);
+    MDArray* avg_out = pool2d_forward(avg_pool, x);
+    double expected_avg[] = {2.5, 4.5, 10.5, 12.5};
+    for (size_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(fabs(expected_avg[i] - ((double*)avg_out->data)[i]) < FLOAT_EPSILON);
+
+    dx = pool2d_backward(avg_pool, avg_out);
+    TEST_ASSERT_TRUE(fabs(2.5 / 4 - ((double*)dx->data)[0]) < FLOAT_EPSILON);
+    TEST_ASSERT_TRUE(fabs(12.5 / 4 - ((double*)dx->data)[15]) < FLOAT_EPSILON);
+
+    mdarray_free(dx);
+    mdarray_free(max_out);
+    mdarray_free(avg_out);
+    pool2d_free(max_pool);
+    pool2d_free(avg_pool);
+    mdarray_free(x);
+}
+
+static void sgd_step(MDArray* param, MDArray* grad, double learning_rate) {
+    for (size_t i = 0; i < param->total_size; i++) {
+        ((double*)param->data)[i] -= learning_rate * ((double*)grad->data)[i];
+    }
+}
+
+void test_small_cnn_trains(void) {
+    // 8 random 6x6 images, targets are random 2-vectors
+    MDArray* x = create_random4(8, 6, 6, 1, 6);
+    size_t target_shape[] = {2, 8};
+    MDArray* targets = mdarray_create(2, target_shape, sizeof(double));
+    RNG rng = rng_new(7);
+    rng_uniform(&rng, targets, -1.0, 1.0);
+
+    Conv2DLayer* conv = conv2d_create(1, 4, 3, 1, 1);
+    Pool2DLayer* pool = pool2d_create(POOL_MAX, 2, 2);
+    LinearLayer* linear = linear_create(3 * 3 * 4, 2);
+    conv2d_init_he(conv, &rng);
+    linear_init_xavier(linear, &rng);
+
+    Layer* layers[] = {layer_conv2d(conv), layer_pool2d(pool), layer_flatten(), layer_linear(linear)};
+    size_t n_layers = 4;
+
+    double first_loss = 0.0, loss = 0.0;
+    for (int epoch = 0; epoch < 30; epoch++) {
+        MDArray* activations[5] = {x};
+        for (size_t l = 0; l < n_layers; l++) {
+            activations[l + 1] = layers[l]->forward(layers[l], activations[l]);
+            TEST_ASSERT_NOT_NULL(activations[l + 1]);
+        }
+
+        loss = mse_loss(activations[n_layers], targets);
+        if (epoch == 0) first_loss = loss;
+
+        MDArray* grad = mse_loss_gradient(activations[n_layers], targets);
+        for (size_t l = n_layers; l > 0; l--) {
+            MDArray* next = layers[l - 1]->backward(layers[l - 1], grad);
+            mdarray_free(grad);
+            grad = next;
+        }
+        mdarray_free(grad);
+
+        sgd_step(conv->weights, conv->grad_weights, 0.1);
+        sgd_step(conv->biases, conv->grad_biases, 0.1);
+        sgd_step(linear->weights, linear->grad_weights, 0.1);
+        mdarray_free(linear->grad_weights);
+        mdarray_free(linear->grad_biases);
+        linear->grad_weights = NULL;
+        linear->grad_biases = NULL;
+
+        for (size_t l = 1; l <= n_layers; l++) mdarray_free(activations[l]);
+    }
+
+    TEST_ASSERT_TRUE(loss < first_loss * 0.5);
+
+    for (size_t l = 0; l < n_layers; l++) layer_free(layers[l]);
+    conv2d_free(conv);
+    pool2d_free(pool);
+    linear_free(linear);
+    mdarray_free(targets);
+    mdarray_free(x);
+}
@@ -0,0 +1,115 @@
+#include <math.h>
+
+#include "unity.h"
+#include "eval.h"
+#include "linear.h"
+#include "loss.h"
+#include "rng.h"
+#include "sparse.h"
+
+#define FEATURES 20
+#define CLASSES 4
+#define SAMPLES 150
+
+void test_eval_matches_full_forward(void) {
+    size_t x_shape[] = {FEATURES, SAMPLES};
+    size_t label_shape[] = {SAMPLES};
+    size_t onehot_shape[] = {CLASSES, SAMPLES};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    MDArray* labels = mdarray_create(1, label_shape, sizeof(double));
+    MDArray* onehot = mdarray_create(2, onehot_shape, sizeof(double));
+    LinearLayer* layer = linear_create(FEATURES, CLASSES);
+    RNG rng = rng_new(9);
+    rng_uniform(&rng, x, -1.0, 1.0);
+    rng_uniform(&rng, labels, 0.0, CLASSES);
+    linear_init_xavier(layer, &rng);
+    mdarray_zeros(onehot);
+    for (size_t j = 0; j < SAMPLES; j++) {
+        double* label = &((double*)labels->data)[j];
+        *label = floor(*label);
+        ((double*)onehot->data)[(size_t)*label * SAMPLES + j] = 1.0;
+    }
+
+    // Reference: everything at once
+    MDArray* out = linear_forward(layer, x);
+    size_t correct = 0, confusion[CLASSES][CLASSES] = {{0}};
+    size_t wrong[5], n_wrong = 0;
+    for (size_t j = 0; j < SAMPLES; j++) {
+        size_t best = 0;
+        for (size_t c = 1; c < CLASSES; c++) {
+            if (((double*)out->data)[c * SAMPLES + j] > ((double*)out->data)[best * SAMPLES + j]) best = c;
+        }
+        size_t label = (size_t)((double*)labels->data)[j];
+        confusion[label][best]++;
+        if (best == label) correct++;
+        else if (n_wrong < 5) wrong[n_wrong++] = j;
+    }
+    double loss = mse_loss(out, onehot);
+
+    // Streamed from a dense and from a sparse copy of the same data,
+    // chunks of 64 so the last one is short
+    SparseMDArray* sparse = sparse_from_dense(x, SPARSE_CSC);
+    size_t misclassified[5];
+    EvalConfig config = {64, misclassified, 5};
+    for (int source = 0; source < 2; source++) {
+        EvalResult result;
+        int status = source == 0
+            ? eval_linear(layer, FEATURES, SAMPLES, eval_fill_dense, x, labels, &config, &result)
+            : eval_linear(layer, FEATURES, SAMPLES, eval_fill_sparse, sparse, labels, &config, &result);
+        TEST_ASSERT_EQUAL(0, status);
+
+        TEST_ASSERT_EQUAL(SAMPLES, result.samples);
+        TEST_ASSERT_EQUAL(correct, result.correct);
+        TEST_ASSERT_TRUE(fabs((double)correct / SAMPLES - result.accuracy) < 1e-12);
+        TEST_ASSERT_TRUE(fabs(loss - result.loss) < 1e-9);
+        for (size_t i = 0; i < CLASSES; i++) {
+            for (size_t j = 0; j < CLASSES; j++) TEST_ASSERT_EQUAL(confusion[i][j], result.confusion[i][j]);
+        }
+        TEST_ASSERT_EQUAL(n_wrong, result.n_misclassified);
+        for (size_t i = 0; i < n_wrong; i++) TEST_ASSERT_EQUAL(wrong[i], misclassified[i]);
+    }
+
+    sparse_free(sparse);
+    mdarray_free(out);
+    mdarray_free(x);
+    mdarray_free(labels);
+    mdarray_free(onehot);
+    linear_free(layer);
+}
+
+void test_eval_rejects_bad_labels(void) {
+    size_t x_shape[] = {FEATURES, 3};
+    size_t label_shape[] = {3};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    MDArray* labels = mdarray_create(1, label_shape, sizeof(double));
+    LinearLayer* layer = linear_create(FEATURES, CLASSES);
+    mdarray_zeros(x);
+    mdarray_zeros(labels);
+    ((double*)labels->data)[1] = CLASSES;
+
+    EvalResult result;
+    TEST_ASSERT_EQUAL(-1, eval_linear(layer, FEATURES, 3, eval_fill_dense, x, labels, NULL, &result));
+    TEST_ASSERT_EQUAL(-1, eval_linear(layer, FEATURES, 4, eval_fill_dense, x, labels, NULL, &result));
+
+    mdarray_free(x);
+    mdarray_free(labels);
+    linear_free(layer);
+}
+
+void test_eval_rejects_mismatched_features(void) {
+    size_t x_shape[] = {FEATURES, 3};
+    size_t label_shape[] = {3};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    MDArray* labels = mdarray_create(1, label_shape, sizeof(double));
+    LinearLayer* layer = linear_create(FEATURES - 1, CLASSES);
+    mdarray_zeros(x);
+    mdarray_zeros(labels);
+
+    // Filling FEATURES rows into chunks of FEATURES - 1 would overrun them
+    EvalResult result;
+    TEST_ASSERT_EQUAL(-1, eval_linear(layer, FEATURES, 3, eval_fill_dense, x, labels, NULL, &result));
+
+    mdarray_free(x);
+    mdarray_free(labels);
+    linear_free(layer);
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <jpeglib.h>
+
+#include "unity.h"
+#include "export.h"
+#include "rng.h"
+
+// Decodes path and returns its dimensions and mean pixel value
+static int read_jpeg(const char* path, size_t* width, size_t* height, double* mean) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return -1;
+
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    jpeg_start_decompress(&cinfo);
+
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    double sum = 0.0;
+    JSAMPLE row[256];
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW rows[1] = {row};
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        for (size_t x = 0; x < *width; x++) sum += row[x];
+    }
+    *mean = sum / (double)(*width * *height);
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return 0;
+}
+
+void test_export_images_and_grid(void) {
+    size_t shape[] = {5, 4, 6};
+    MDArray* images = mdarray_create(3, shape, sizeof(double));
+    mdarray_zeros(images);
+    // Image 3 is white, the others black
+    for (size_t i = 0; i < 24; i++) ((double*)images->data)[3 * 24 + i] = 255.0;
+
+    char prefix[64], grid[64], path[96];
+    snprintf(prefix, sizeof(prefix), "/tmp/nnc_export_%d", (int)getpid());
+    snprintf(grid, sizeof(grid), "/tmp/nnc_export_grid_%d.jpeg", (int)getpid());
+
+    ExportConfig config = export_default_config();
+    config.quality = 100;
+    Exporter* exporter = exporter_create(&config);
+    TEST_ASSERT_NOT_NULL(exporter);
+
+    size_t indices[] = {3, 1};
+    TEST_ASSERT_EQUAL(0, exporter_images(exporter, images, indices, 2, prefix));
+    TEST_ASSERT_EQUAL(-1, exporter_images(exporter, images, (size_t[]){5}, 1, prefix));
+    exporter_flush(exporter);
+    // The caller may reuse its images once the export returned
+    mdarray_zeros(images);
+    for (size_t i = 0; i < 24; i++) ((double*)images->data)[i] = 255.0;
+    TEST_ASSERT_EQUAL(0, exporter_grid(exporter, images, NULL, 5, 2, grid));
+    exporter_flush(exporter);
+
+    size_t width, height;
+    double mean;
+    snprintf(path, sizeof(path), "%s_3.jpeg", prefix);
+    TEST_ASSERT_EQUAL(0, read_jpeg(path, &width, &height, &mean));
+    TEST_ASSERT_EQUAL(6, width);
+    TEST_ASSERT_EQUAL(4, height);
+    TEST_ASSERT_TRUE(mean > 250.0);
+    remove(path);
+
+    snprintf(path, sizeof(path), "%s_1.jpeg", prefix);
+    TEST_ASSERT_EQUAL(0, read_jpeg(path, &width, &height, &mean));
+    TEST_ASSERT_TRUE(mean < 5.0);
+    remove(path);
+
+    // 5 tiles in rows of 2, one white tile out of six slots
+    TEST_ASSERT_EQUAL(0, read_jpeg(grid, &width, &height, &mean));
+    TEST_ASSERT_EQUAL(12, width);
+    TEST_ASSERT_EQUAL(12, height);
+    TEST_ASSERT_DOUBLE_WITHIN(10.0, 255.0 / 6.0, mean);
+    remove(grid);
+
+    TEST_ASSERT_EQUAL(0, exporter_dropped(exporter));
+    exporter_free(exporter);
+    mdarray_free(images);
+}
+
+void test_export_survives_jpeg_errors(void) {
+    size_t shape[] = {2, 4, 6};
+    MDArray* images = mdarray_create(3, shape, sizeof(double));
+    mdarray_zeros(images);
+
+    Exporter* exporter = exporter_create(NULL);
+    TEST_ASSERT_NOT_NULL(exporter);
+
+    // libjpeg fails flushing to a full device, the exporter carries on
+    TEST_ASSERT_EQUAL(0, exporter_grid(exporter, images, NULL, 2, 2, "/dev/full"));
+    exporter_flush(exporter);
+    TEST_ASSERT_EQUAL(1, exporter_failed(exporter));
+
+    char grid[64];
+    size_t width, height;
+    double mean;
+    snprintf(grid, sizeof(grid), "/tmp/nnc_export_after_error_%d.jpeg", (int)getpid());
+    TEST_ASSERT_EQUAL(0, exporter_grid(exporter, images, NULL, 2, 2, grid));
+    exporter_flush(exporter);
+    TEST_ASSERT_EQUAL(1, exporter_failed(exporter));
+    TEST_ASSERT_EQUAL(0, read_jpeg(grid, &width, &height, &mean));
+    TEST_ASSERT_EQUAL(12, width);
+    remove(grid);
+
+    // Grids beyond JPEG's 65500 pixels per side are refused up front
+    TEST_ASSERT_EQUAL(-1, exporter_grid(exporter, images, NULL, 2, 65500 / 6 + 1, grid));
+
+    size_t tall_shape[] = {2, 32800, 1};
+    MDArray* tall = mdarray_create(3, tall_shape, sizeof(double));
+    mdarray_zeros(tall);
+    TEST_ASSERT_EQUAL(-1, exporter_grid(exporter, tall, NULL, 2, 1, grid));
+    TEST_ASSERT_EQUAL(0, exporter_dropped(exporter));
+
+    mdarray_free(tall);
+    exporter_free(exporter);
+    mdarray_free(images);
+}
@@ -0,0 +1,147 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unity.h"
+#include "allocator.h"
+#include "autotune.h"
+#include "gemm.h"
+#include "mdarray.h"
+#include "rng.h"
+
+#define FLOAT_EPSILON 0.0001f
+
+static MDArray* create_random(size_t rows, size_t cols, uint64_t seed) {
+    size_t shape[] = {rows, cols};
+    MDArray* arr = mdarray_create(2, shape, sizeof(double));
+    RNG rng = rng_new(seed);
+    rng_uniform(&rng, arr, -1.0, 1.0);
+    return arr;
+}
+
+static double reference_at(MDArray* a, MDArray* b, size_t i, size_t j) {
+    double sum = 0.0;
+    for (size_t p = 0; p < a->shape[1]; p++) {
+        sum += ((double*)a->data)[i * a->shape[1] + p] * ((double*)b->data)[p * b->shape[1] + j];
+    }
+    return sum;
+}
+
+void test_gemm_matches_reference(void) {
+    // Odd sizes exercise the zero-padded edge slivers
+    size_t m = 13, k = 37, n = 29;
+    MDArray* a = create_random(m, k, 1);
+    MDArray* b = create_random(k, n, 2);
+    size_t c_shape[] = {m, n};
+    MDArray* c = mdarray_create(2, c_shape, sizeof(double));
+
+    size_t kernels[][2] = {{4, 4}, {4, 8}, {8, 4}, {8, 8}};
+    for (size_t t = 0; t < 4; t++) {
+        // Tiny blocks so every loop level runs more than once
+        GemmConfig config = {8, 16, 8, kernels[t][0], kernels[t][1], 3};
+        gemm_dgemm(m, n, k, a->data, k, 1, b->data, n, 1, c->data, n, 1, 0, &config);
+
+        for (size_t i = 0; i < m; i++) {
+            for (size_t j = 0; j < n; j++) {
+                TEST_ASSERT_TRUE(fabs(reference_at(a, b, i, j) - ((double*)c->data)[i * n + j]) < FLOAT_EPSILON);
+            }
+        }
+    }
+
+    mdarray_free(a);
+    mdarray_free(b);
+    mdarray_free(c);
+}
+
+void test_gemm_strided_and_accumulate(void) {
+    size_t m = 5, k = 9, n = 6;
+    MDArray* a = create_random(m, k, 3);
+    MDArray* b = create_random(k, n, 4);
+    MDArray* at = mdarray_transpose(a);
+
+    size_t c_shape[] = {m, n};
+    MDArray* c = mdarray_create(2, c_shape, sizeof(double));
+    mdarray_ones(c);
+
+    // Read A through its transpose: element (i, p) lives at at[p, i]
+    GemmConfig config = gemm_default_config();
+    gemm_dgemm(m, n, k, at->data, 1, m, b->data, n, 1, c->data, n, 1, 1, &config);
+
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+            TEST_ASSERT_TRUE(fabs(1.0 + reference_at(a, b, i, j) - ((double*)c->data)[i * n + j]) < FLOAT_EPSILON);
+        }
+    }
+
+    mdarray_free(a);
+    mdarray_free(b);
+    mdarray_free(at);
+    mdarray_free(c);
+}
+
+static void* failing_alloc(void* ctx, size_t bytes) {
+    (void)ctx;
+    (void)bytes;
+    return NULL;
+}
+
+static void failing_free(void* ctx, void* ptr, size_t bytes) {
+    (void)ctx;
+    (void)ptr;
+    (void)bytes;
+}
+
+void test_gemm_without_pack_buffers(void) {
+    size_t m = 7, k = 11, n = 9;
+    MDArray* a = create_random(m, k, 5);
+    MDArray* b = create_random(k, n, 6);
+    size_t c_shape[] = {m, n};
+    MDArray* c = mdarray_create(2, c_shape, sizeof(double));
+    mdarray_ones(c);
+
+    // Every chunk falls back to the unpacked loop, C must still be complete
+    Allocator allocator = {failing_alloc, failing_free, NULL};
+    allocator_set(&allocator);
+    GemmConfig config = {8, 16, 8, 4, 4, 3};
+    gemm_dgemm(m, n, k, a->data, k, 1, b->data, n, 1, c->data, n, 1, 1, &config);
+    allocator_set(NULL);
+
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+            TEST_ASSERT_TRUE(fabs(1.0 + reference_at(a, b, i, j) - ((double*)c->data)[i * n + j]) < FLOAT_EPSILON);
+        }
+    }
+
+    mdarray_free(a);
+    mdarray_free(b);
+    mdarray_free(c);
+}
+
+void test_autotune_cache_roundtrip(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/nnc_tuning_%d/cache.tsv", (int)getpid());
+
+    GemmConfig tuned = autotune_gemm(10, 64, 784);
+    TEST_ASSERT_TRUE(gemm_config_valid(&tuned));
+    TEST_ASSERT_EQUAL(0, autotune_save(path));
+
+    // Same shape class resolves to the tuned configuration
+    GemmConfig found = autotune_lookup(10, 60, 700);
+    TEST_ASSERT_EQUAL(tuned.kc, found.kc);
+    TEST_ASSERT_EQUAL(tuned.mr, found.mr);
+    TEST_ASSERT_EQUAL(tuned.nr, found.nr);
+
+    TEST_ASSERT_EQUAL(0, autotune_load(path));
+    FILE* file = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(file);
+    char line[512];
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), file));
+    TEST_ASSERT_TRUE(strncmp(line, autotune_cpu_model(), strlen(autotune_cpu_model())) == 0);
+    fclose(file);
+
+    remove(path);
+    path[strlen(path) - strlen("/cache.tsv")] = '\0';
+    rmdir(path);
+}
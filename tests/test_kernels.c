@@ -0,0 +1,95 @@
+#include <math.h>
+
+#include "unity.h"
+#include "kernels.h"
+#include "linear.h"
+#include "loss.h"
+#include "rng.h"
+
+#define IN_FEATURES 784
+#define OUT_FEATURES 10
+#define BATCH 32
+
+static int arrays_close(MDArray* a, MDArray* b) {
+    if (!a || !b || a->total_size != b->total_size) return 0;
+    for (size_t i = 0; i < a->total_size; i++) {
+        if (fabs(((double*)a->data)[i] - ((double*)b->data)[i]) > 1e-9) return 0;
+    }
+    return 1;
+}
+
+// Forward, MSE gradient and backward of one batch, gradients left in layer
+static MDArray* run_step(LinearLayer* layer, MDArray* x, MDArray* targets, double* loss, MDArray** dx) {
+    MDArray* out = linear_forward(layer, x);
+    *loss = mse_loss(out, targets);
+    MDArray* grad = mse_loss_gradient(out, targets);
+    *dx = linear_backward(layer, grad);
+    mdarray_free(grad);
+    return out;
+}
+
+void test_specialized_linear_matches_generic(void) {
+    if (!kernels_find_linear(IN_FEATURES, OUT_FEATURES, BATCH)) {
+        TEST_IGNORE_MESSAGE("784x10 batch 32 is not in the configured kernel shapes");
+    }
+    TEST_ASSERT_NULL(kernels_find_linear(IN_FEATURES, OUT_FEATURES, BATCH + 1));
+
+    size_t x_shape[] = {IN_FEATURES, BATCH};
+    size_t t_shape[] = {OUT_FEATURES, BATCH};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    MDArray* targets = mdarray_create(2, t_shape, sizeof(double));
+    LinearLayer* layer = linear_create(IN_FEATURES, OUT_FEATURES);
+    RNG rng = rng_new(3);
+    rng_uniform(&rng, x, 0.0, 1.0);
+    rng_uniform(&rng, targets, 0.0, 1.0);
+    linear_init_xavier(layer, &rng);
+    rng_uniform(&rng, layer->biases, -0.1, 0.1);
+
+    double loss, generic_loss;
+    MDArray *dx, *generic_dx;
+    MDArray* out = run_step(layer, x, targets, &loss, &dx);
+    MDArray* dw = layer->grad_weights;
+    MDArray* db = layer->grad_biases;
+    layer->grad_weights = NULL;
+    layer->grad_biases = NULL;
+
+    kernels_set_enabled(0);
+    MDArray* generic_out = run_step(layer, x, targets, &generic_loss, &generic_dx);
+    kernels_set_enabled(1);
+
+    TEST_ASSERT_TRUE(arrays_close(out, generic_out));
+    TEST_ASSERT_TRUE(fabs(loss - generic_loss) < 1e-9);
+    TEST_ASSERT_TRUE(arrays_close(dx, generic_dx));
+    TEST_ASSERT_TRUE(arrays_close(dw, layer->grad_weights));
+    TEST_ASSERT_TRUE(arrays_close(db, layer->grad_biases));
+
+    mdarray_free(out);
+    mdarray_free(generic_out);
+    mdarray_free(dx);
+    mdarray_free(generic_dx);
+    mdarray_free(dw);
+    mdarray_free(db);
+    mdarray_free(x);
+    mdarray_free(targets);
+    linear_free(layer);
+}
+
+void test_undeclared_shape_uses_generic_kernels(void) {
+    // Batch 3 is never declared, the generic path must still be correct
+    TEST_ASSERT_NULL(kernels_find_linear(IN_FEATURES, OUT_FEATURES, 3));
+
+    size_t x_shape[] = {IN_FEATURES, 3};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    mdarray_ones(x);
+    LinearLayer* layer = linear_create(IN_FEATURES, OUT_FEATURES);
+
+    MDArray* out = linear_forward(layer, x);
+    TEST_ASSERT_NOT_NULL(out);
+    for (size_t i = 0; i < out->total_size; i++) {
+        TEST_ASSERT_TRUE(fabs((double)IN_FEATURES - ((double*)out->data)[i]) < 1e-9);
+    }
+
+    mdarray_free(out);
+    mdarray_free(x);
+    linear_free(layer);
+}
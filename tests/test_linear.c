@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -7,6 +8,7 @@
 #include "mdarray.h"
 #include "linear.h"
 #include "loss.h"
+#include "rng.h"
 
 void test_backpropagation(void) {
     // Create input data (2 samples, 3 features each)
@@ -37,11 +39,8 @@ void test_backpropagation(void) {
     }
 
     // Initialize weights with small random values
-    srand(42); // Fixed seed for reproducibility
-    for (size_t i = 0; i < layer->weights->total_size; i++) {
-        double* weight = (double*)((char*)layer->weights->data + i * sizeof(double));
-        *weight = (((double)rand() / RAND_MAX) * 2 - 1) * 0.01;
-    }
+    RNG rng = rng_new(42); // Fixed seed for reproducibility
+    rng_uniform(&rng, layer->weights, -0.01, 0.01);
 
     double learning_rate = 0.01;
     int epochs = 50;
@@ -103,8 +102,46 @@ void test_backpropagation(void) {
     }
 
     // Clean up
-    mdarray_free(layer->weights);
-    mdarray_free(layer->biases);
+    linear_free(layer);
     mdarray_free(input);
     mdarray_free(targets);
-}
\ No newline at end of file
+}
+
+void test_linear_backward_on_freed_batch_slice(void) {
+    // 3 features x 4 samples, train on the zero-copy slice of samples 1..2
+    size_t shape[] = {3, 4};
+    MDArray* data = mdarray_create(2, shape, sizeof(double));
+    for (size_t i = 0; i < 12; i++) ((double*)data->data)[i] = (double)(i + 1);
+
+    MDArray* batch = mdarray_slice(data, 1, 1, 3);
+    MDArray* packed = mdarray_contiguous(batch);
+    LinearLayer* layer = linear_create(3, 2);
+    RNG rng = rng_new(1);
+    rng_uniform(&rng, layer->weights, -1.0, 1.0);
+
+    MDArray* out = linear_forward(layer, batch);
+    TEST_ASSERT_NOT_NULL(out);
+
+    // The layer keeps its own reference, so the caller may drop the batch
+    mdarray_free(batch);
+    mdarray_free(data);
+
+    MDArray* grad_input = linear_backward(layer, out);
+    TEST_ASSERT_NOT_NULL(grad_input);
+
+    // dW = out * batch^T computed from the packed copy
+    for (size_t o = 0; o < 2; o++) {
+        for (size_t f = 0; f < 3; f++) {
+            double expected = 0.0;
+            for (size_t b = 0; b < 2; b++) {
+                expected += ((double*)out->data)[o * 2 + b] * ((double*)packed->data)[f * 2 + b];
+            }
+            TEST_ASSERT_TRUE(fabs(expected - ((double*)layer->grad_weights->data)[o * 3 + f]) < 1e-9);
+        }
+    }
+
+    mdarray_free(grad_input);
+    mdarray_free(out);
+    mdarray_free(packed);
+    linear_free(layer);
+}
@@ -161,3 +161,127 @@ void test_md_array_sum_three_dimensions(void) {
     TEST_ASSERT_EQUAL(15, *result_0_1_0);
     TEST_ASSERT_EQUAL(15, *result_0_1_1);
 }
+
+void test_mdarray_views_outlive_parent(void) {
+    // 3x4 matrix holding 0..11
+    size_t shape[] = {3, 4};
+    MDArray* arr = mdarray_create(2, shape, sizeof(double));
+    for (size_t i = 0; i < 12; i++) ((double*)arr->data)[i] = (double)i;
+
+    MDArray* columns = mdarray_slice(arr, 1, 1, 3);  // [3, 2], strided
+    MDArray* transposed = mdarray_transpose_view(arr); // [4, 3]
+    size_t start[] = {2};
+    MDArray* row = mdarray_copy(arr, 1, start);        // [4]
+    TEST_ASSERT_EQUAL_PTR(arr->buffer, columns->buffer);
+    TEST_ASSERT_EQUAL(4, atomic_load(&arr->buffer->refcount));
+    TEST_ASSERT_FALSE(mdarray_is_contiguous(columns));
+    TEST_ASSERT_TRUE(mdarray_is_contiguous(row));
+
+    mdarray_free(arr);
+
+    size_t idx[] = {2, 1};
+    TEST_ASSERT_EQUAL(10, *(double*)mdarray_get_element(columns, idx));
+    size_t tidx[] = {3, 1};
+    TEST_ASSERT_EQUAL(7, *(double*)mdarray_get_element(transposed, tidx));
+    size_t ridx[] = {3};
+    TEST_ASSERT_EQUAL(11, *(double*)mdarray_get_element(row, ridx));
+
+    // Element-wise ops pack strided operands: columns + columns
+    MDArray* sum = mdarray_sum(columns, columns);
+    double expected[] = {2, 4, 10, 12, 18, 20};
+    for (size_t i = 0; i < 6; i++) TEST_ASSERT_TRUE(float_eq(expected[i], ((double*)sum->data)[i]));
+
+    MDArray* packed = mdarray_contiguous(columns);
+    TEST_ASSERT_TRUE(mdarray_is_contiguous(packed));
+    TEST_ASSERT_TRUE(packed->buffer != columns->buffer);
+    for (size_t i = 0; i < 6; i++) TEST_ASSERT_TRUE(float_eq(expected[i] / 2, ((double*)packed->data)[i]));
+
+    // Writing through a plain view is visible to the other views
+    mdarray_zeros(columns);
+    size_t r0[] = {0}, r1[] = {1};
+    TEST_ASSERT_EQUAL(8, *(double*)mdarray_get_element(row, r0));
+    TEST_ASSERT_EQUAL(0, *(double*)mdarray_get_element(row, r1));
+    TEST_ASSERT_EQUAL(11, *(double*)mdarray_get_element(row, ridx));
+
+    mdarray_free(packed);
+    mdarray_free(sum);
+    mdarray_free(row);
+    mdarray_free(transposed);
+    mdarray_free(columns);
+}
+
+void test_mdarray_copy_on_write(void) {
+    size_t shape[] = {2, 2};
+    MDArray* arr = mdarray_create(2, shape, sizeof(double));
+    mdarray_ones(arr);
+
+    MDArray* snapshot = mdarray_cow_view(arr);
+    TEST_ASSERT_EQUAL_PTR(arr->data, snapshot->data);
+
+    // The first write detaches the writer, the other side keeps the old values
+    double value = 5.0;
+    size_t idx[] = {0, 1};
+    mdarray_set_element(arr, idx, &value);
+    TEST_ASSERT_TRUE(arr->data != snapshot->data);
+    TEST_ASSERT_EQUAL(5, *(double*)mdarray_get_element(arr, idx));
+    TEST_ASSERT_EQUAL(1, *(double*)mdarray_get_element(snapshot, idx));
+    TEST_ASSERT_EQUAL(1, atomic_load(&snapshot->buffer->refcount));
+
+    // Read-only buffers are copied before any write
+    snapshot->buffer->readonly = 1;
+    MDArray* view = mdarray_view(snapshot);
+    mdarray_zeros(view);
+    TEST_ASSERT_EQUAL(0, *(double*)mdarray_get_element(view, idx));
+    TEST_ASSERT_EQUAL(1, *(double*)mdarray_get_element(snapshot, idx));
+
+    mdarray_free(view);
+    mdarray_free(snapshot);
+    mdarray_free(arr);
+}
+
+void test_mdarray_inline_and_heap_shapes(void) {
+    // Up to MDARRAY_MAX_INLINE_DIMS dimensions live inside the struct
+    size_t small_shape[] = {2, 3, 4};
+    MDArray* small = mdarray_create(3, small_shape, sizeof(double));
+    TEST_ASSERT_EQUAL_PTR(small->inline_shape, small->shape);
+    TEST_ASSERT_EQUAL_PTR(small->inline_strides, small->strides);
+
+    // Higher ranks fall back to the heap and still index correctly
+    size_t big_shape[] = {2, 1, 3, 1, 2, 2};
+    MDArray* big = mdarray_create(6, big_shape, sizeof(double));
+    TEST_ASSERT_TRUE(big->shape != big->inline_shape);
+    TEST_ASSERT_EQUAL(24, big->total_size);
+    TEST_ASSERT_EQUAL(12, big->strides[0]);
+    TEST_ASSERT_EQUAL(1, big->strides[5]);
+    mdarray_zeros(big);
+    double value = 3.0;
+    size_t idx[] = {1, 0, 2, 0, 1, 0};
+    mdarray_set_element(big, idx, &value);
+    TEST_ASSERT_EQUAL(3, ((double*)big->data)[12 + 8 + 2]);
+
+    MDArray* transposed = mdarray_transpose_view(big);
+    size_t tidx[] = {0, 1, 0, 2, 0, 1};
+    TEST_ASSERT_EQUAL(3, *(double*)mdarray_get_element(transposed, tidx));
+
+    // A view keeps the data of a freed array alive, and an array that
+    // moved to a private copy still frees cleanly after its view
+    MDArray* view = mdarray_slice(small, 2, 1, 3);
+    size_t parent_strides[] = {small->strides[0], small->strides[1], small->strides[2]};
+    mdarray_ones(small);
+    mdarray_free(small);
+    size_t vidx[] = {1, 2, 1};
+    size_t view_shape[] = {2, 3, 2};
+    for (size_t d = 0; d < 3; d++) {
+        TEST_ASSERT_EQUAL(view_shape[d], view->shape[d]);
+        TEST_ASSERT_EQUAL(parent_strides[d], view->strides[d]);
+    }
+    TEST_ASSERT_EQUAL(1, *(double*)mdarray_get_element(view, vidx));
+
+    MDArray* snapshot = mdarray_cow_view(big);
+    mdarray_zeros(big);
+    mdarray_free(snapshot);
+
+    mdarray_free(view);
+    mdarray_free(transposed);
+    mdarray_free(big);
+}
@@ -0,0 +1,139 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "mdarray.h"
+#include "linear.h"
+#include "parallel.h"
+#include "rng.h"
+
+static MDArray* create_vector(size_t n) {
+    size_t shape[] = {n};
+    return mdarray_create(1, shape, sizeof(double));
+}
+
+void test_philox_known_answer(void) {
+    // Known answer from the Random123 Philox4x32-10 test vectors
+    uint32_t counter[4] = {0, 0, 0, 0};
+    uint32_t key[2] = {0, 0};
+    uint32_t out[4];
+    philox4x32(counter, key, out);
+
+    TEST_ASSERT_EQUAL_UINT(0x6627e8d5u, out[0]);
+    TEST_ASSERT_EQUAL_UINT(0xe169c58du, out[1]);
+    TEST_ASSERT_EQUAL_UINT(0xbc57ac4cu, out[2]);
+    TEST_ASSERT_EQUAL_UINT(0x9b00dbd8u, out[3]);
+}
+
+void test_rng_same_result_for_any_thread_count(void) {
+    size_t n = 100000;
+    MDArray* serial = create_vector(n);
+    MDArray* threaded = create_vector(n);
+
+    size_t saved_threads = parallel_num_threads();
+
+    parallel_set_num_threads(1);
+    RNG rng = rng_new(1234);
+    rng_normal(&rng, serial, 0.0, 1.0);
+
+    parallel_set_num_threads(4);
+    rng = rng_new(1234);
+    rng_normal(&rng, threaded, 0.0, 1.0);
+
+    parallel_set_num_threads(saved_threads);
+
+    TEST_ASSERT_EQUAL_MEMORY(serial->data, threaded->data, n * sizeof(double));
+
+    // The stream advanced, so the next fill differs
+    rng_normal(&rng, threaded, 0.0, 1.0);
+    TEST_ASSERT_TRUE(memcmp(serial->data, threaded->data, n * sizeof(double)) != 0);
+
+    mdarray_free(serial);
+    mdarray_free(threaded);
+}
+
+void test_rng_distributions(void) {
+    size_t n = 100000;
+    MDArray* arr = create_vector(n);
+    double* data = (double*)arr->data;
+    RNG rng = rng_new(7);
+
+    rng_uniform(&rng, arr, -2.0, 3.0);
+    double mean = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_TRUE(data[i] >= -2.0 && data[i] < 3.0);
+        mean += data[i] / n;
+    }
+    TEST_ASSERT_TRUE(fabs(mean - 0.5) < 0.05);
+
+    rng_normal(&rng, arr, 1.0, 2.0);
+    mean = 0.0;
+    double var = 0.0;
+    for (size_t i = 0; i < n; i++) mean += data[i] / n;
+    for (size_t i = 0; i < n; i++) var += (data[i] - mean) * (data[i] - mean) / n;
+    TEST_ASSERT_TRUE(fabs(mean - 1.0) < 0.05);
+    TEST_ASSERT_TRUE(fabs(sqrt(var) - 2.0) < 0.05);
+
+    rng_truncated_normal(&rng, arr, 0.0, 0.5);
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_TRUE(fabs(data[i]) <= 1.0);
+    }
+
+    rng_dropout_mask(&rng, arr, 0.25);
+    size_t dropped = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (data[i] == 0.0) {
+            dropped++;
+        } else {
+            TEST_ASSERT_TRUE(fabs(data[i] - 1.0 / 0.75) < 1e-12);
+        }
+    }
+    TEST_ASSERT_TRUE(fabs((double)dropped / n - 0.25) < 0.01);
+
+    mdarray_free(arr);
+}
+
+void test_rng_permutation(void) {
+    size_t n = 1000;
+    RNG rng = rng_new(99);
+    size_t* perm = rng_permutation(&rng, n);
+    TEST_ASSERT_NOT_NULL(perm);
+
+    char* seen = calloc(n, 1);
+    size_t moved = 0;
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_TRUE(perm[i] < n);
+        TEST_ASSERT_FALSE(seen[perm[i]]);
+        seen[perm[i]] = 1;
+        if (perm[i] != i) moved++;
+    }
+    TEST_ASSERT_TRUE(moved > n / 2);
+
+    free(seen);
+    free(perm);
+}
+
+void test_linear_initializers(void) {
+    LinearLayer* layer = linear_create(784, 10);
+    RNG rng = rng_new(3);
+
+    linear_init_xavier(layer, &rng);
+    double limit = sqrt(6.0 / (784 + 10));
+    double* weights = (double*)layer->weights->data;
+    for (size_t i = 0; i < layer->weights->total_size; i++) {
+        TEST_ASSERT_TRUE(fabs(weights[i]) <= limit);
+    }
+
+    // Corrected for the truncation, the weights keep He's variance of 2 / fan_in
+    linear_init_he(layer, &rng);
+    double stddev = sqrt(2.0 / 784) / RNG_TRUNCATED_STDDEV;
+    double var = 0.0;
+    for (size_t i = 0; i < layer->weights->total_size; i++) {
+        TEST_ASSERT_TRUE(fabs(weights[i]) <= 2.0 * stddev);
+        var += weights[i] * weights[i] / layer->weights->total_size;
+    }
+    TEST_ASSERT_TRUE(fabs(var / (2.0 / 784) - 1.0) < 0.05);
+
+    linear_free(layer);
+}
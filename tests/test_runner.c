@@ -5,9 +5,78 @@ void test_mdarray_creation_and_access(void);
 void test_mdarray_dot_product(void);
 void test_md_array_sum_one_dimension(void);
 void test_md_array_sum_three_dimensions(void);
+void test_mdarray_views_outlive_parent(void);
+void test_mdarray_copy_on_write(void);
+void test_mdarray_inline_and_heap_shapes(void);
 
 // Declarations of test functions from test_linear.c
 void test_backpropagation(void);
+void test_linear_backward_on_freed_batch_slice(void);
+
+// Declarations of test functions from test_sparse.c
+void test_sparse_roundtrip(void);
+void test_sparse_dense_dot(void);
+void test_dense_sparse_t_dot(void);
+void test_linear_sparse_input(void);
+
+// Declarations of test functions from test_rng.c
+void test_philox_known_answer(void);
+void test_rng_same_result_for_any_thread_count(void);
+void test_rng_distributions(void);
+void test_rng_permutation(void);
+void test_linear_initializers(void);
+
+// Declarations of test functions from test_allocator.c
+void test_allocator_alignment(void);
+void test_allocator_huge_pages(void);
+void test_allocator_stats(void);
+void test_allocator_custom(void);
+
+// Declarations of test functions from test_gemm.c
+void test_gemm_matches_reference(void);
+void test_gemm_strided_and_accumulate(void);
+void test_gemm_without_pack_buffers(void);
+void test_autotune_cache_roundtrip(void);
+
+// Declarations of test functions from test_server.c
+void test_server_batches_requests(void);
+
+// Declarations of test functions from test_conv.c
+void test_conv2d_forward_algorithms_agree(void);
+void test_conv2d_backward_gradients(void);
+void test_conv2d_im2col_without_scratch(void);
+void test_conv_pool_backward_check_grad_output(void);
+void test_pool2d_max_and_avg(void);
+void test_small_cnn_trains(void);
+
+// Declarations of test functions from test_scheduler.c
+void test_task_dependencies_run_in_order(void);
+void test_nested_parallel_for(void);
+
+// Declarations of test functions from test_kernels.c
+void test_specialized_linear_matches_generic(void);
+void test_undeclared_shape_uses_generic_kernels(void);
+
+// Declarations of test functions from test_eval.c
+void test_eval_matches_full_forward(void);
+void test_eval_rejects_bad_labels(void);
+void test_eval_rejects_mismatched_features(void);
+
+// Declarations of test functions from test_checkpoint.c
+void test_checkpoint_roundtrip_is_zero_copy(void);
+void test_checkpoint_rejects_corruption(void);
+void test_checkpoint_copies_on_write(void);
+void test_linear_checkpoint_roundtrip(void);
+
+// Declarations of test functions from test_train.c
+void test_train_micro_batches_match_full_batch(void);
+void test_train_recompute_matches_full_batch(void);
+void test_train_memory_budget_picks_micro_batch(void);
+void test_train_memory_budget_on_fresh_model(void);
+
+// Declarations of test functions from test_export.c
+void test_export_images_and_grid(void);
+void test_export_survives_jpeg_errors(void);
 
 int main(void) {
     UNITY_BEGIN();
@@ -17,9 +86,78 @@ int main(void) {
     RUN_TEST(test_mdarray_dot_product);
     RUN_TEST(test_md_array_sum_one_dimension);
     RUN_TEST(test_md_array_sum_three_dimensions);
+    RUN_TEST(test_mdarray_views_outlive_parent);
+    RUN_TEST(test_mdarray_copy_on_write);
+    RUN_TEST(test_mdarray_inline_and_heap_shapes);
 
     // Run tests from test_linear.c
     RUN_TEST(test_backpropagation);
+    RUN_TEST(test_linear_backward_on_freed_batch_slice);
+
+    // Run tests from test_sparse.c
+    RUN_TEST(test_sparse_roundtrip);
+    RUN_TEST(test_sparse_dense_dot);
+    RUN_TEST(test_dense_sparse_t_dot);
+    RUN_TEST(test_linear_sparse_input);
+
+    // Run tests from test_rng.c
+    RUN_TEST(test_philox_known_answer);
+    RUN_TEST(test_rng_same_result_for_any_thread_count);
+    RUN_TEST(test_rng_distributions);
+    RUN_TEST(test_rng_permutation);
+    RUN_TEST(test_linear_initializers);
+
+    // Run tests from test_allocator.c
+    RUN_TEST(test_allocator_alignment);
+    RUN_TEST(test_allocator_huge_pages);
+    RUN_TEST(test_allocator_stats);
+    RUN_TEST(test_allocator_custom);
+
+    // Run tests from test_gemm.c
+    RUN_TEST(test_gemm_matches_reference);
+    RUN_TEST(test_gemm_strided_and_accumulate);
+    RUN_TEST(test_gemm_without_pack_buffers);
+    RUN_TEST(test_autotune_cache_roundtrip);
+
+    // Run tests from test_server.c
+    RUN_TEST(test_server_batches_requests);
+
+    // Run tests from test_conv.c
+    RUN_TEST(test_conv2d_forward_algorithms_agree);
+    RUN_TEST(test_conv2d_backward_gradients);
+    RUN_TEST(test_conv2d_im2col_without_scratch);
+    RUN_TEST(test_conv_pool_backward_check_grad_output);
+    RUN_TEST(test_pool2d_max_and_avg);
+    RUN_TEST(test_small_cnn_trains);
+
+    // Run tests from test_scheduler.c
+    RUN_TEST(test_task_dependencies_run_in_order);
+    RUN_TEST(test_nested_parallel_for);
+
+    // Run tests from test_kernels.c
+    RUN_TEST(test_specialized_linear_matches_generic);
+    RUN_TEST(test_undeclared_shape_uses_generic_kernels);
+
+    // Run tests from test_eval.c
+    RUN_TEST(test_eval_matches_full_forward);
+    RUN_TEST(test_eval_rejects_bad_labels);
+    RUN_TEST(test_eval_rejects_mismatched_features);
+
+    // Run tests from test_checkpoint.c
+    RUN_TEST(test_checkpoint_roundtrip_is_zero_copy);
+    RUN_TEST(test_checkpoint_rejects_corruption);
+    RUN_TEST(test_checkpoint_copies_on_write);
+    RUN_TEST(test_linear_checkpoint_roundtrip);
+
+    // Run tests from test_train.c
+    RUN_TEST(test_train_micro_batches_match_full_batch);
+    RUN_TEST(test_train_recompute_matches_full_batch);
+    RUN_TEST(test_train_memory_budget_picks_micro_batch);
+    RUN_TEST(test_train_memory_budget_on_fresh_model);
+
+    // Run tests from test_export.c
+    RUN_TEST(test_export_images_and_grid);
+    RUN_TEST(test_export_survives_jpeg_errors);
 
     return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "unity.h"
+#include "parallel.h"
+#include "scheduler.h"
+
+typedef struct {
+    atomic_size_t clock;
+    size_t finished_at[4];
+} DiamondLog;
+
+typedef struct {
+    DiamondLog* log;
+    size_t id;
+} DiamondNode;
+
+static void diamond_step(void* ctx) {
+    DiamondNode* node = (DiamondNode*)ctx;
+    node->log->finished_at[node->id] = atomic_fetch_add(&node->log->clock, 1);
+}
+
+void test_task_dependencies_run_in_order(void) {
+    // a -> {b, c} -> d, repeated so both orders of b and c get a chance
+    for (int round = 0; round < 50; round++) {
+        DiamondLog log;
+        atomic_init(&log.clock, 0);
+        DiamondNode nodes[4];
+        Task* tasks[4];
+        for (size_t i = 0; i < 4; i++) {
+            nodes[i].log = &log;
+            nodes[i].id = i;
+            tasks[i] = task_create(diamond_step, &nodes[i]);
+            TEST_ASSERT_NOT_NULL(tasks[i]);
+        }
+        TEST_ASSERT_EQUAL(0, task_depends_on(tasks[1], tasks[0]));
+        TEST_ASSERT_EQUAL(0, task_depends_on(tasks[2], tasks[0]));
+        TEST_ASSERT_EQUAL(0, task_depends_on(tasks[3], tasks[1]));
+        TEST_ASSERT_EQUAL(0, task_depends_on(tasks[3], tasks[2]));
+
+        // Submit in reverse, nothing may start before its dependencies
+        for (size_t i = 4; i > 0; i--) task_submit(tasks[i - 1]);
+        task_wait(tasks[3]);
+
+        for (size_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(task_done(tasks[i]));
+        TEST_ASSERT_TRUE(log.finished_at[0] < log.finished_at[1]);
+        TEST_ASSERT_TRUE(log.finished_at[0] < log.finished_at[2]);
+        TEST_ASSERT_TRUE(log.finished_at[1] < log.finished_at[3]);
+        TEST_ASSERT_TRUE(log.finished_at[2] < log.finished_at[3]);
+
+        for (size_t i = 0; i < 4; i++) task_release(tasks[i]);
+    }
+}
+
+typedef struct {
+    atomic_size_t* cells;
+    size_t width;
+} Grid;
+
+static void inner_range(void* ctx, size_t begin, size_t end) {
+    atomic_size_t* row = (atomic_size_t*)ctx;
+    for (size_t i = begin; i < end; i++) atomic_fetch_add(&row[i], 1);
+}
+
+static void outer_range(void* ctx, size_t begin, size_t end) {
+    Grid* grid = (Grid*)ctx;
+    for (size_t r = begin; r < end; r++) {
+        parallel_for(grid->width, 1, inner_range, &grid->cells[r * grid->width]);
+    }
+}
+
+void test_nested_parallel_for(void) {
+    // Every chunk of the outer loop waits on its own inner loop
+    size_t rows = 64, width = 100;
+    Grid grid = {calloc(rows * width, sizeof(atomic_size_t)), width};
+    TEST_ASSERT_NOT_NULL(grid.cells);
+
+    parallel_for(rows, 1, outer_range, &grid);
+
+    for (size_t i = 0; i < rows * width; i++) TEST_ASSERT_EQUAL(1, atomic_load(&grid.cells[i]));
+    free(grid.cells);
+}
@@ -0,0 +1,92 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "unity.h"
+#include "linear.h"
+#include "rng.h"
+#include "server.h"
+
+#define FLOAT_EPSILON 0.0001f
+
+typedef struct {
+    LinearLayer* layer;
+    ServerConfig config;
+} ServerThread;
+
+static void* run_server(void* arg) {
+    ServerThread* st = (ServerThread*)arg;
+    server_run(st->layer, &st->config);
+    return NULL;
+}
+
+static int connect_to(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    // The server thread may still be binding
+    for (int attempt = 0; attempt < 100; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+void test_server_batches_requests(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/nnc_test_%d.sock", (int)getpid());
+
+    RNG rng = rng_new(5);
+    LinearLayer* layer = linear_create(6, 3);
+    linear_init_xavier(layer, &rng);
+    rng_uniform(&rng, layer->biases, -1.0, 1.0);
+
+    ServerThread st = {layer, server_default_config(path)};
+    st.config.max_batch = 4;
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_server, &st);
+
+    // A single request must match a direct forward pass
+    int fd = connect_to(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    double input[6] = {0.0, 1.0, 0.0, 2.0, 0.5, 0.0};
+    double output[3];
+    TEST_ASSERT_EQUAL(sizeof(input), send(fd, input, sizeof(input), 0));
+    TEST_ASSERT_EQUAL(sizeof(output), recv(fd, output, sizeof(output), MSG_WAITALL));
+    close(fd);
+
+    for (size_t o = 0; o < 3; o++) {
+        double expected = ((double*)layer->biases->data)[o];
+        for (size_t f = 0; f < 6; f++) {
+            expected += ((double*)layer->weights->data)[o * 6 + f] * input[f];
+        }
+        TEST_ASSERT_TRUE(fabs(expected - output[o]) < FLOAT_EPSILON);
+    }
+
+    LoadgenConfig config = {4, 50, 6, 3};
+    LoadgenResult result;
+    TEST_ASSERT_EQUAL(0, server_loadgen(path, &config, &result));
+    TEST_ASSERT_EQUAL(200, result.requests);
+    TEST_ASSERT_EQUAL(0, result.errors);
+    TEST_ASSERT_TRUE(result.p50_us <= result.p99_us);
+
+    // The single request plus the load. Four clients against max_batch 4
+    // must have shared some forward passes, and no batch may exceed it
+    ServerStats stats = server_stats();
+    TEST_ASSERT_EQUAL(201, stats.requests);
+    TEST_ASSERT_TRUE(stats.batches < stats.requests);
+    TEST_ASSERT_TRUE(stats.largest_batch > 1);
+    TEST_ASSERT_TRUE(stats.largest_batch <= 4);
+
+    server_stop();
+    pthread_join(thread, NULL);
+    linear_free(layer);
+}
@@ -0,0 +1,137 @@
+#include <math.h>
+#include <string.h>
+
+#include "unity.h"
+#include "mdarray.h"
+#include "sparse.h"
+#include "linear.h"
+
+#define FLOAT_EPSILON 0.0001f
+
+// 4x3 matrix with 3 non-zero elements
+static MDArray* create_sparse_input(void) {
+    size_t shape[] = {4, 3};
+    MDArray* x = mdarray_create(2, shape, sizeof(double));
+    double data[] = {
+        0.0, 2.0, 0.0,
+        1.0, 0.0, 0.0,
+        0.0, 0.0, 0.0,
+        0.0, 0.0, 4.0,
+    };
+    memcpy(x->data, data, sizeof(data));
+    return x;
+}
+
+static MDArray* create_weights(void) {
+    size_t shape[] = {2, 4};
+    MDArray* w = mdarray_create(2, shape, sizeof(double));
+    for (size_t i = 0; i < w->total_size; i++) {
+        ((double*)w->data)[i] = (double)i + 1;
+    }
+    return w;
+}
+
+static void assert_arrays_equal(MDArray* expected, MDArray* actual) {
+    TEST_ASSERT_NOT_NULL(actual);
+    TEST_ASSERT_EQUAL(expected->shape[0], actual->shape[0]);
+    TEST_ASSERT_EQUAL(expected->shape[1], actual->shape[1]);
+    for (size_t i = 0; i < expected->total_size; i++) {
+        TEST_ASSERT_TRUE(fabs(((double*)expected->data)[i] - ((double*)actual->data)[i]) < FLOAT_EPSILON);
+    }
+}
+
+void test_sparse_roundtrip(void) {
+    MDArray* x = create_sparse_input();
+
+    SparseMDArray* csr = sparse_from_dense(x, SPARSE_CSR);
+    SparseMDArray* csc = sparse_from_dense(x, SPARSE_CSC);
+    TEST_ASSERT_EQUAL(3, csr->nnz);
+    TEST_ASSERT_EQUAL(3, csc->nnz);
+    TEST_ASSERT_TRUE(fabs(sparse_density(csr) - 3.0 / 12.0) < FLOAT_EPSILON);
+
+    MDArray* from_csr = sparse_to_dense(csr);
+    MDArray* from_csc = sparse_to_dense(csc);
+    assert_arrays_equal(x, from_csr);
+    assert_arrays_equal(x, from_csc);
+
+    // Too dense for the requested threshold
+    TEST_ASSERT_NULL(sparse_try_from_dense(x, SPARSE_CSC, 0.2));
+
+    mdarray_free(from_csr);
+    mdarray_free(from_csc);
+    sparse_free(csr);
+    sparse_free(csc);
+    mdarray_free(x);
+}
+
+void test_sparse_dense_dot(void) {
+    MDArray* x = create_sparse_input();
+    MDArray* w = create_weights();
+    MDArray* expected = mdarray_dot(w, x);
+
+    SparseMDArray* formats[] = {sparse_from_dense(x, SPARSE_CSR), sparse_from_dense(x, SPARSE_CSC)};
+    for (size_t f = 0; f < 2; f++) {
+        MDArray* out = sparse_dense_dot(w, formats[f]);
+        assert_arrays_equal(expected, out);
+        mdarray_free(out);
+        sparse_free(formats[f]);
+    }
+
+    mdarray_free(expected);
+    mdarray_free(w);
+    mdarray_free(x);
+}
+
+void test_dense_sparse_t_dot(void) {
+    MDArray* x = create_sparse_input();
+
+    // Gradient 2x3 against input 4x3 gives 2x4 weight gradient
+    size_t g_shape[] = {2, 3};
+    MDArray* g = mdarray_create(2, g_shape, sizeof(double));
+    double g_data[] = {1.0, -1.0, 0.5, 2.0, 0.0, -3.0};
+    memcpy(g->data, g_data, sizeof(g_data));
+
+    MDArray* xt = mdarray_transpose(x);
+    MDArray* expected = mdarray_dot(g, xt);
+
+    SparseMDArray* formats[] = {sparse_from_dense(x, SPARSE_CSR), sparse_from_dense(x, SPARSE_CSC)};
+    for (size_t f = 0; f < 2; f++) {
+        MDArray* out = dense_sparse_t_dot(g, formats[f]);
+        assert_arrays_equal(expected, out);
+        mdarray_free(out);
+        sparse_free(formats[f]);
+    }
+
+    mdarray_free(expected);
+    mdarray_free(xt);
+    mdarray_free(g);
+    mdarray_free(x);
+}
+
+void test_linear_sparse_input(void) {
+    MDArray* x = create_sparse_input();
+    LinearLayer* layer = linear_create(4, 2);
+    ((double*)layer->biases->data)[1] = 0.5;
+
+    // 3 of 12 elements are non-zero, so the sparse kernel is picked
+    TEST_ASSERT_TRUE(mdarray_density(x) < SPARSE_DENSITY_THRESHOLD);
+    MDArray* out = linear_forward(layer, x);
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_NOT_NULL(layer->sparse_input);
+
+    // weights are all ones, so out[i, n] = sum(x[:, n]) + bias[i]
+    double expected[] = {1.0, 2.0, 4.0, 1.5, 2.5, 4.5};
+    for (size_t i = 0; i < 6; i++) {
+        TEST_ASSERT_TRUE(fabs(expected[i] - ((double*)out->data)[i]) < FLOAT_EPSILON);
+    }
+
+    MDArray* grad_input = linear_backward(layer, out);
+    TEST_ASSERT_NOT_NULL(layer->grad_weights);
+    TEST_ASSERT_EQUAL(2, layer->grad_weights->shape[0]);
+    TEST_ASSERT_EQUAL(4, layer->grad_weights->shape[1]);
+
+    mdarray_free(grad_input);
+    mdarray_free(out);
+    linear_free(layer);
+    mdarray_free(x);
+}
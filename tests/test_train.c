@@ -0,0 +1,243 @@
+#include <math.h>
+
+#include "unity.h"
+#include "allocator.h"
+#include "conv.h"
+#include "layer.h"
+#include "linear.h"
+#include "loss.h"
+#include "pool.h"
+#include "rng.h"
+#include "train.h"
+
+#define GRAD_EPSILON 1e-9
+
+typedef struct {
+    Conv2DLayer* conv;
+    Pool2DLayer* pool;
+    LinearLayer* linear;
+    Layer* layers[4];
+    Sequential* model;
+} SmallCNN;
+
+static void small_cnn_init(SmallCNN* cnn) {
+    RNG rng = rng_new(11);
+    cnn->conv = conv2d_create(1, 3, 3, 1, 1);
+    cnn->pool = pool2d_create(POOL_MAX, 2, 2);
+    cnn->linear = linear_create(3 * 3 * 3, 2);
+    conv2d_init_he(cnn->conv, &rng);
+    linear_init_xavier(cnn->linear, &rng);
+    rng_uniform(&rng, cnn->linear->biases, -0.5, 0.5);
+
+    cnn->layers[0] = layer_conv2d(cnn->conv);
+    cnn->layers[1] = layer_pool2d(cnn->pool);
+    cnn->layers[2] = layer_flatten();
+    cnn->layers[3] = layer_linear(cnn->linear);
+    cnn->model = sequential_create(cnn->layers, 4);
+}
+
+static void small_cnn_free(SmallCNN* cnn) {
+    sequential_free(cnn->model);
+    for (size_t l = 0; l < 4; l++) layer_free(cnn->layers[l]);
+    conv2d_free(cnn->conv);
+    pool2d_free(cnn->pool);
+    linear_free(cnn->linear);
+}
+
+static void assert_arrays_equal(MDArray* expected, MDArray* actual) {
+    TEST_ASSERT_NOT_NULL(actual);
+    TEST_ASSERT_EQUAL(expected->total_size, actual->total_size);
+    for (size_t i = 0; i < expected->total_size; i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(GRAD_EPSILON, ((double*)expected->data)[i], ((double*)actual->data)[i]);
+    }
+}
+
+static MDArray* copy_of(MDArray* arr) {
+    MDArray* copy = mdarray_create(arr->ndim, arr->shape, sizeof(double));
+    for (size_t i = 0; i < arr->total_size; i++) ((double*)copy->data)[i] = ((double*)arr->data)[i];
+    return copy;
+}
+
+// Gradients of a plain full-batch forward and backward
+static double full_batch_gradients(SmallCNN* cnn, MDArray* x, MDArray* targets) {
+    MDArray* activations[5] = {x};
+    for (size_t l = 0; l < 4; l++) {
+        activations[l + 1] = cnn->layers[l]->forward(cnn->layers[l], activations[l]);
+    }
+    double loss = mse_loss(activations[4], targets);
+
+    MDArray* grad = mse_loss_gradient(activations[4], targets);
+    for (size_t l = 4; l > 0; l--) {
+        MDArray* next = cnn->layers[l - 1]->backward(cnn->layers[l - 1], grad);
+        mdarray_free(grad);
+        grad = next;
+    }
+    mdarray_free(grad);
+    for (size_t l = 1; l <= 4; l++) mdarray_free(activations[l]);
+
+    return loss;
+}
+
+static void check_micro_batches(int recompute) {
+    size_t x_shape[] = {10, 6, 6, 1};
+    size_t target_shape[] = {2, 10};
+    MDArray* x = mdarray_create(4, x_shape, sizeof(double));
+    MDArray* targets = mdarray_create(2, target_shape, sizeof(double));
+    RNG rng = rng_new(4);
+    rng_uniform(&rng, x, -1.0, 1.0);
+    rng_uniform(&rng, targets, -1.0, 1.0);
+
+    SmallCNN cnn;
+    small_cnn_init(&cnn);
+    double expected_loss = full_batch_gradients(&cnn, x, targets);
+    MDArray* conv_dw = copy_of(cnn.conv->grad_weights);
+    MDArray* conv_db = copy_of(cnn.conv->grad_biases);
+    MDArray* linear_dw = copy_of(cnn.linear->grad_weights);
+    MDArray* linear_db = copy_of(cnn.linear->grad_biases);
+
+    if (recompute) {
+        sequential_set_recompute(cnn.model, 0, 1);
+        sequential_set_recompute(cnn.model, 1, 1);
+    }
+
+    // 10 samples as 4 + 4 + 2, run twice to check zeroing between batches
+    TrainConfig config = {4, 0, 0};
+    double loss = train_batch_gradients(cnn.model, x, targets, &config);
+    loss = train_batch_gradients(cnn.model, x, targets, &config);
+    TEST_ASSERT_DOUBLE_WITHIN(GRAD_EPSILON, expected_loss, loss);
+    assert_arrays_equal(conv_dw, cnn.conv->grad_weights);
+    assert_arrays_equal(conv_db, cnn.conv->grad_biases);
+    assert_arrays_equal(linear_dw, cnn.linear->grad_weights);
+    assert_arrays_equal(linear_db, cnn.linear->grad_biases);
+
+    // Accumulation only lasts for the batch
+    TEST_ASSERT_EQUAL(0, cnn.conv->accumulate);
+    TEST_ASSERT_EQUAL(0, cnn.linear->accumulate);
+
+    // Saved activations are dropped once backward is done with them
+    TEST_ASSERT_NULL(cnn.conv->input);
+    TEST_ASSERT_NULL(cnn.pool->input);
+    TEST_ASSERT_NULL(cnn.linear->input);
+
+    mdarray_free(conv_dw);
+    mdarray_free(conv_db);
+    mdarray_free(linear_dw);
+    mdarray_free(linear_db);
+    small_cnn_free(&cnn);
+    mdarray_free(targets);
+    mdarray_free(x);
+}
+
+void test_train_micro_batches_match_full_batch(void) {
+    check_micro_batches(0);
+}
+
+void test_train_recompute_matches_full_batch(void) {
+    check_micro_batches(1);
+}
+
+void test_train_memory_budget_picks_micro_batch(void) {
+    size_t x_shape[] = {300, 64};
+    size_t target_shape[] = {4, 64};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    MDArray* targets = mdarray_create(2, target_shape, sizeof(double));
+    RNG rng = rng_new(8);
+    rng_uniform(&rng, x, -1.0, 1.0);
+    rng_uniform(&rng, targets, -1.0, 1.0);
+
+    LinearLayer* linear = linear_create(300, 4);
+    linear_init_xavier(linear, &rng);
+    Layer* layers[] = {layer_linear(linear)};
+    Sequential* model = sequential_create(layers, 1);
+
+    // Without a budget the whole batch runs at once
+    TrainConfig config = train_default_config();
+    size_t live = allocator_stats().live_bytes;
+    allocator_reset_peak();
+    double expected_loss = train_batch_gradients(model, x, targets, &config);
+    size_t full_batch_bytes = allocator_stats().peak_bytes - live;
+    MDArray* expected_dw = copy_of(linear->grad_weights);
+
+    // Each sample packs 300 doubles of input, so 16 KiB holds a handful.
+    // Probes and micro-batches stay well below the full batch, and the
+    // probes' gradients do not leak into the result.
+    config.memory_budget = 16 * 1024;
+    live = allocator_stats().live_bytes;
+    allocator_reset_peak();
+    double loss = train_batch_gradients(model, x, targets, &config);
+    TEST_ASSERT_TRUE(allocator_stats().peak_bytes - live < full_batch_bytes / 2);
+    TEST_ASSERT_DOUBLE_WITHIN(GRAD_EPSILON, expected_loss, loss);
+    assert_arrays_equal(expected_dw, linear->grad_weights);
+
+    mdarray_free(expected_dw);
+    sequential_free(model);
+    layer_free(layers[0]);
+    linear_free(linear);
+    mdarray_free(targets);
+    mdarray_free(x);
+}
+
+// Gradients of 512 x 256 weights dwarf a sample's 512 inputs
+#define FRESH_FEATURES 512
+#define FRESH_OUTPUTS 256
+#define FRESH_SAMPLES 32
+
+// A linear model with the same parameters every time
+static Sequential* fresh_linear_model(LinearLayer** linear, Layer** layer) {
+    RNG rng = rng_new(8);
+    *linear = linear_create(FRESH_FEATURES, FRESH_OUTPUTS);
+    linear_init_xavier(*linear, &rng);
+    *layer = layer_linear(*linear);
+    return sequential_create(layer, 1);
+}
+
+// Runs one train_batch_gradients, counting its allocations
+static double counted_batch(Sequential* model, MDArray* x, MDArray* targets, const TrainConfig* config,
+                            size_t* allocations) {
+    size_t before = allocator_stats().allocations;
+    double loss = train_batch_gradients(model, x, targets, config);
+    *allocations = allocator_stats().allocations - before;
+    return loss;
+}
+
+void test_train_memory_budget_on_fresh_model(void) {
+    size_t x_shape[] = {FRESH_FEATURES, FRESH_SAMPLES};
+    size_t target_shape[] = {FRESH_OUTPUTS, FRESH_SAMPLES};
+    MDArray* x = mdarray_create(2, x_shape, sizeof(double));
+    MDArray* targets = mdarray_create(2, target_shape, sizeof(double));
+    RNG rng = rng_new(9);
+    rng_uniform(&rng, x, -1.0, 1.0);
+    rng_uniform(&rng, targets, -1.0, 1.0);
+
+    // Three identical models that each run a single batch, so the budgeted
+    // one has no gradients when its probes run
+    LinearLayer* linear[3];
+    Layer* layer[3];
+    Sequential* model[3];
+    for (size_t m = 0; m < 3; m++) model[m] = fresh_linear_model(&linear[m], &layer[m]);
+
+    TrainConfig config = train_default_config();
+    size_t full_allocations, single_allocations, allocations;
+    double expected_loss = counted_batch(model[0], x, targets, &config, &full_allocations);
+    config.micro_batch = 1;
+    counted_batch(model[1], x, targets, &config, &single_allocations);
+
+    // A step needs about 256 KiB regardless of size plus 12 KiB per sample, so
+    // 512 KiB fits a couple of micro-batches. Counting the first probe's
+    // fresh gradients as step memory would leave room for single samples.
+    config.micro_batch = 0;
+    config.memory_budget = 512 * 1024;
+    double loss = counted_batch(model[2], x, targets, &config, &allocations);
+    TEST_ASSERT_TRUE(allocations > full_allocations);
+    TEST_ASSERT_TRUE(allocations < single_allocations / 2);
+    TEST_ASSERT_DOUBLE_WITHIN(GRAD_EPSILON, expected_loss, loss);
+    assert_arrays_equal(linear[0]->grad_weights, linear[2]->grad_weights);
+
+    for (size_t m = 0; m < 3; m++) {
+        sequential_free(model[m]);
+        layer_free(layer[m]);
+        linear_free(linear[m]);
+    }
+    mdarray_free(targets);
+    mdarray_free(x);
+}